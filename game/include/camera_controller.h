@@ -2,6 +2,7 @@
 
 #include "object_transform.h"
 #include "doom_map.h"
+#include "map_collision.h"
 
 class CameraController
 {
@@ -10,6 +11,12 @@ protected:
 	ObjectTransform HeadNode;
 	ObjectTransform HandNode;
 
+	// the sector under the player, found from the one it was in last frame
+	WADFile::SectorTracker Tracker;
+
+	// keeps the player out of the walls
+	MapCollider Collider;
+
 public:
 	CameraController();
 	virtual ~CameraController() = default;
@@ -5,10 +5,12 @@
 
 namespace DoomRender
 {
-    void DrawMapSectorPolygons(const WADFile::LevelMap& map, size_t selectedSector);
-    void DrawMapSegs(const WADFile::LevelMap& map, size_t selectedSector, size_t selectedSubSector);
+    // only draws what is inside view, the visible area in world units, found with the map's quadtrees
+    void DrawMapSectorPolygons(const WADFile::LevelMap& map, size_t selectedSector, const Rectangle& view, size_t hoveredLine = size_t(-1), size_t selectedLine = size_t(-1));
+    void DrawMapSegs(const WADFile::LevelMap& map, size_t selectedSector, size_t selectedSubSector, const Rectangle& view, size_t hoveredLine = size_t(-1), size_t selectedLine = size_t(-1));
 
-    void DrawMap3d(const WADFile::LevelMap& map);
+    // only draws what the map's PVS says may be visible from the view position, everything when it has none
+    void DrawMap3d(const WADFile::LevelMap& map, Vector3 viewPosition);
 
-    Texture2D GetTexture(const std::string& name, const WADFile& wad);
+    Texture2D GetTexture(uint16_t textureId, const WADFile& wad);
 }
\ No newline at end of file
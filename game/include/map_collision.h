@@ -0,0 +1,42 @@
+#pragma once
+
+#include "doom_map.h"
+#include "raylib.h"
+
+#include <vector>
+
+// Moves a circle through a level the way the player moves, sliding along the lines it can't cross instead of going through them.
+// Only the lines near the move are tested, found with the level's line tree, and long moves are cut short, so a move costs the same on any size of map.
+class MapCollider
+{
+public:
+	// in world units, the defaults are the Doom player's 16 unit radius, 56 unit height and 24 unit step
+	float Radius = 16 * WADData::MapScale;
+	float Height = 56 * WADData::MapScale;
+	float StepHeight = 24 * WADData::MapScale;
+
+	// how many times a move can be turned along a wall, corners take two
+	int MaxSlides = 3;
+
+	// the longest a single move can be, anything further is cut short
+	float MaxMoveDistance = 256 * WADData::MapScale;
+
+	struct MoveResult
+	{
+		Vector3 Position = { 0 };
+
+		// the linedef the move last slid along, size_t(-1) when nothing was in the way
+		size_t BlockingLine = size_t(-1);
+	};
+
+	// sweeps the circle from position, with its feet at position.z, along delta and returns where it ends up
+	// the height is left alone, the caller puts the feet on the floor it ends up over
+	MoveResult Move(const WADFile::LevelMap& map, Vector3 position, Vector2 delta);
+
+	// true when the circle can't cross the line from a place with its feet at z, because it is one sided, impassable, too high a step or too low a gap
+	bool IsBlocking(const WADFile::LevelMap& map, size_t lineIndex, float z) const;
+
+protected:
+	// the lines near the current move that block it, kept so moves don't allocate once it has grown
+	std::vector<uint32_t> Candidates;
+};
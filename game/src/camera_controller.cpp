@@ -34,6 +34,8 @@ void CameraController::Update(const WADFile::LevelMap& map)
 	if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
 		HeadNode.RotateH(GetMouseDelta().y * 0.125f);
 
+	Vector3 start = BaseNode.GetWorldPosition();
+
 	// move the player based on it's local transform
 	if (IsKeyDown(KEY_W))
 		BaseNode.MoveV(runspeed);
@@ -47,11 +49,18 @@ void CameraController::Update(const WADFile::LevelMap& map)
 	if (IsKeyDown(KEY_D))
 		BaseNode.MoveH(runspeed);
 
-	Vector3 pos = BaseNode.GetWorldPosition();
+	// the keys moved the base freely, that move is swept against the walls from where it started
+	Vector3 moved = BaseNode.GetWorldPosition();
+	Vector3 pos = Collider.Move(map, start, Vector2{ moved.x - start.x, moved.y - start.y }).Position;
 
-	size_t sector = map.GetSectorFromPoint(pos.x, pos.y);
+	// the sector grid knows most places with one read, the tracker covers the cells that straddle a line
+	size_t sector = size_t(-1);
+	if (!map.GetSectorFromGrid(pos.x, pos.y, sector))
+		sector = Tracker.Update(map, Vector2{ pos.x, pos.y });
 	if (sector != size_t(-1))
-		BaseNode.SetPosition(pos.x, pos.y, map.Sectors->Contents[sector].Floor);
+		pos.z = map.Sectors->Contents[sector].Floor;
+
+	BaseNode.SetPosition(pos.x, pos.y, pos.z);
 }
 
 Vector3 CameraController::GetPosition()
@@ -62,6 +71,7 @@ Vector3 CameraController::GetPosition()
 void CameraController::SetPosition(const Vector3& pos)
 {
 	BaseNode.SetPosition(pos);
+	Tracker.Reset();
 }
 
 void CameraController::SetCamera(Camera3D& camera)
@@ -4,94 +4,113 @@
 #include "raymath.h"
 #include "rlgl.h"
 
+#include <algorithm>
+
 namespace DoomRender
 {
-    std::unordered_map<std::string, Texture2D> FlatCache;
-	std::unordered_map<std::string, Texture2D> TextureCache;
+    // indexed by the IDs in the WAD name tables, a texture with an id of 0 has not been uploaded
+    std::vector<Texture2D> FlatCache;
+	std::vector<Texture2D> TextureCache;
 
-    Texture2D GetFlat(const std::string& name, const WADFile& wad)
-    {
-        auto itr = FlatCache.find(name);
-        if (itr != FlatCache.end())
-            return itr->second;
+	static Texture2D GetCachedTexture(std::vector<Texture2D>& cache, const std::vector<Image>& images, uint16_t id)
+	{
+		if (id < cache.size() && cache[id].id != 0)
+			return cache[id];
 
-        auto imageItr = wad.Flats.find(name);
-        if (imageItr == wad.Flats.end())
-            return Texture2D{ 0 };
+		if (id >= images.size() || images[id].data == nullptr)
+			return Texture2D{ 0 };
+
+		if (id >= cache.size())
+			cache.resize(images.size(), Texture2D{ 0 });
 
-        Texture2D texture = LoadTextureFromImage(imageItr->second);
-        FlatCache[name] = texture;
-        return texture;
+		cache[id] = LoadTextureFromImage(images[id]);
+		return cache[id];
+	}
+
+    Texture2D GetFlat(uint16_t flatId, const WADFile& wad)
+    {
+        return GetCachedTexture(FlatCache, wad.Flats, flatId);
     }
 
-	Texture2D GetTexture(const std::string& name, const WADFile& wad)
+	Texture2D GetTexture(uint16_t textureId, const WADFile& wad)
 	{
-		auto itr = TextureCache.find(name);
-		if (itr != TextureCache.end())
-			return itr->second;
+		return GetCachedTexture(TextureCache, wad.Textures, textureId);
+	}
 
-		auto imageItr = wad.Textures.find(name);
-		if (imageItr == wad.Textures.end())
-			return Texture2D{ 0 };
+    // per frame scratch for the 2d view, what the quadtrees found in the view
+    static std::vector<uint32_t> ViewItems;
 
-		Texture2D texture = LoadTextureFromImage(imageItr->second);
-		TextureCache[name] = texture;
-		return texture;
-	}
+    static WADData::QuadTree::Bounds ToBounds(const Rectangle& rect)
+    {
+        return WADData::QuadTree::Bounds{ rect.x, rect.y, rect.x + rect.width, rect.y + rect.height };
+    }
 
-    void DrawThigs(const WADFile::LevelMap& map)
+    // fills ViewItems with what the tree has in the view, it only grows when a view holds more than it ever has
+    static void FindInView(const WADData::QuadTree& tree, const Rectangle& view)
     {
-		for (const auto& thing : map.Things->Contents)
+        ViewItems.resize(ViewItems.capacity());
+        size_t count = tree.FindInBox(ToBounds(view), ViewItems);
+        if (count > ViewItems.size())
+        {
+            ViewItems.resize(count);
+            tree.FindInBox(ToBounds(view), ViewItems);
+        }
+        ViewItems.resize(count);
+    }
+
+    void DrawThigs(const WADFile::LevelMap& map, const Rectangle& view)
+    {
+        FindInView(map.ThingTree, view);
+		for (uint32_t thing : ViewItems)
 		{
-			DrawCircleV(thing.Position, 0.25f, YELLOW);
+			DrawCircleV(map.Things->Contents[thing].Position, 0.25f, YELLOW);
 		}
     }
 
-    void DrawMapSectorPolygons(const WADFile::LevelMap& map, size_t selectedSector)
+    static void DrawMapLine(const WADFile::LevelMap& map, size_t lineIndex, float thickness, Color color)
+    {
+        if (lineIndex >= map.Lines->Contents.size())
+            return;
+
+        const auto line = map.Lines->Contents[lineIndex];
+        DrawLineEx(map.Vertices.Get(line.Start), map.Vertices.Get(line.End), thickness, color);
+    }
+
+    void DrawMapSectorPolygons(const WADFile::LevelMap& map, size_t selectedSector, const Rectangle& view, size_t hoveredLine, size_t selectedLine)
     {
         if (map.Verts == nullptr)
 			return;
 
-        for (const auto& sector : map.SectorCache)
+        FindInView(map.LineTree, view);
+        for (uint32_t lineIndex : ViewItems)
         {
-            for (const auto& edge : sector.Edges)
-            {
-                const auto& line = map.Lines->Contents[edge.Line];
-
-                const auto& sp = map.Verts->Contents[line.Start].Position;
-                const auto& ep = map.Verts->Contents[line.End].Position;
-
-				Color c = WHITE;
-				if (edge.Reverse)
-				{
-					if (edge.Destination != WADData::InvalidSectorIndex)
-						c = BLUE;
-					else
-						c = DARKBLUE;
-				}
-				else
-				{
-                    if (edge.Destination != WADData::InvalidSectorIndex)
-                        c = GREEN;
-                    else
-                        c = DARKGREEN;
-				}
-
-                if (edge.Reverse)
-                    DrawLineEx(sp, ep, 0.125f,  c);
-                else
-					DrawLineEx(ep, sp, 0.125f, c);
-            }
+            const auto line = map.Lines->Contents[lineIndex];
+
+            size_t frontSector = line.FrontSideDef != WADData::InvalidSideDefIndex ? map.Sides->Contents[line.FrontSideDef].SectorId : WADData::InvalidSectorIndex;
+            size_t backSector = line.BackSideDef != WADData::InvalidSideDefIndex ? map.Sides->Contents[line.BackSideDef].SectorId : WADData::InvalidSectorIndex;
+
+            // two sided lines are edges of both their sectors, they used to be drawn sector by sector so the later sector's colour shows
+            Color c = WHITE;
+            if (frontSector != WADData::InvalidSectorIndex && backSector != WADData::InvalidSectorIndex)
+                c = frontSector > backSector ? GREEN : BLUE;
+            else if (frontSector != WADData::InvalidSectorIndex)
+                c = DARKGREEN;
+            else if (backSector != WADData::InvalidSectorIndex)
+                c = DARKBLUE;
+            else
+                continue;
+
+            DrawMapLine(map, lineIndex, 0.125f, c);
         }
         rlDrawRenderBatchActive();
         if (selectedSector < map.SectorCache.size())
         {
             for (const auto& edge : map.SectorCache[selectedSector].Edges)
             {
-				const auto& line = map.Lines->Contents[edge.Line];
+				const auto line = map.Lines->Contents[edge.Line];
 
-				const auto& sp = map.Verts->Contents[line.Start].Position;
-				const auto& ep = map.Verts->Contents[line.End].Position;
+				const auto& sp = map.Vertices.Get(line.Start);
+				const auto& ep = map.Vertices.Get(line.End);
 
 				if (edge.Reverse)
 					DrawLineEx(sp, ep, 0.125f, RED);
@@ -101,14 +120,33 @@ namespace DoomRender
 
             rlDrawRenderBatchActive();
         }
-        DrawThigs(map);
+
+        DrawMapLine(map, selectedLine, 0.2f, ORANGE);
+        DrawMapLine(map, hoveredLine, 0.2f, GOLD);
+        rlDrawRenderBatchActive();
+
+        DrawThigs(map, view);
     }
 
-	void DrawMapSegs(const WADFile::LevelMap& map, size_t selectedSector, size_t selectedSubSector)
+	void DrawMapSegs(const WADFile::LevelMap& map, size_t selectedSector, size_t selectedSubSector, const Rectangle& view, size_t hoveredLine, size_t selectedLine)
 	{
-        for (const auto& sector : map.SectorCache)
+        // the subsectors in view, grouped by sector so each floor texture is bound once
+        FindInView(map.SubSectorTree, view);
+
+        auto sectorOf = [&](uint32_t subSector) { return subSector < map.SubSectorPlaces.size() ? map.SubSectorPlaces[subSector].Sector : uint32_t(-1); };
+        std::sort(ViewItems.begin(), ViewItems.end(), [&](uint32_t a, uint32_t b) { return sectorOf(a) < sectorOf(b); });
+
+        for (size_t run = 0; run < ViewItems.size();)
         {
-            auto& rawSector = map.Sectors->Contents[sector.SectorIndex];
+            uint32_t sectorIndex = sectorOf(ViewItems[run]);
+            size_t runEnd = run;
+            while (runEnd < ViewItems.size() && sectorOf(ViewItems[runEnd]) == sectorIndex)
+                runEnd++;
+
+            if (sectorIndex >= map.Sectors->Contents.size())
+                break;
+
+            auto& rawSector = map.Sectors->Contents[sectorIndex];
             Texture2D floor = GetFlat(rawSector.FloorTexture, map.SourceWad);
             rlSetTexture(floor.id);
 
@@ -116,21 +154,19 @@ namespace DoomRender
             rlColor4f(1, 1, 1, 1);
             rlNormal3f(0, 0, 1);
 
-            for (size_t subsectorIndex : sector.SubSectors)
+            for (; run < runEnd; run++)
             {
-                const auto& glSubSector = map.GLSubSectors->Contents[subsectorIndex];
+                const auto& glSubSector = map.GLSubSectors->Contents[ViewItems[run]];
 
                 float lightLevel = rawSector.LightLevel / 255.0f;
                 rlColor4f(lightLevel, lightLevel, lightLevel, 1);
 
-                Vector2 origin = map.GetVertex(map.GLSegs->Contents[glSubSector.StartSegment].Start, map.GLSegs->Contents[glSubSector.StartSegment].StartIsGL);
+                Vector2 origin = map.Vertices.Get(map.GLSegStarts[glSubSector.StartSegment]);
 
 				for (size_t index = glSubSector.StartSegment+1; index < glSubSector.StartSegment + glSubSector.Count; index++)
 				{
-					const auto& segment = map.GLSegs->Contents[index];
-
-                    Vector2 sp = map.GetVertex(segment.Start, segment.StartIsGL);
-					Vector2 ep = map.GetVertex(segment.End, segment.EndIsGL);
+                    Vector2 sp = map.Vertices.Get(map.GLSegStarts[index]);
+					Vector2 ep = map.Vertices.Get(map.GLSegEnds[index]);
 
                     rlTexCoord2f(origin.x/2.0f, origin.y / 2.0f);
                     rlVertex2f(origin.x, origin.y);
@@ -150,7 +186,7 @@ namespace DoomRender
             rlSetTexture(0);
         }
 
-        DrawMapSectorPolygons(map, selectedSector);
+        DrawMapSectorPolygons(map, selectedSector, view, hoveredLine, selectedLine);
 
 		if (selectedSector < map.SectorCache.size())
 		{
@@ -167,10 +203,8 @@ namespace DoomRender
 
 				for (size_t index = subSector.StartSegment; index < subSector.StartSegment + subSector.Count; index++)
 				{
-					const auto& segment = map.GLSegs->Contents[index];
-
-					Vector2 sp = map.GetVertex(segment.Start, segment.StartIsGL);
-					Vector2 ep = map.GetVertex(segment.End, segment.EndIsGL);
+					Vector2 sp = map.Vertices.Get(map.GLSegStarts[index]);
+					Vector2 ep = map.Vertices.Get(map.GLSegEnds[index]);
 
 					DrawLineEx(sp, ep, 0.15f, PURPLE);
 				}
@@ -179,11 +213,107 @@ namespace DoomRender
 		}
 	}
 
-	void DrawMap3d(const WADFile::LevelMap& map)
+	// per frame scratch for DrawMap3d, the visible subsectors grouped by sector, the sectors they are in,
+	// and where each sector's run starts in VisibleSubSectors, with the end of the last run after them
+	static std::vector<size_t> VisibleSubSectors;
+	static std::vector<uint32_t> VisibleSectors;
+	static std::vector<size_t> VisibleSectorStarts;
+
+	// a sector is visible this frame when its stamp matches FrameStamp, so nothing is cleared between frames
+	static std::vector<uint32_t> SectorStamps;
+	static uint32_t FrameStamp = 0;
+
+	static void NextFrameStamp(const WADFile::LevelMap& map)
+	{
+		if (++FrameStamp == 0 || SectorStamps.size() != map.SectorCache.size())
+		{
+			SectorStamps.assign(map.SectorCache.size(), 0);
+			FrameStamp = 1;
+		}
+	}
+
+	static void AddVisibleSector(uint32_t sectorIndex, size_t start)
+	{
+		SectorStamps[sectorIndex] = FrameStamp;
+		VisibleSectors.push_back(sectorIndex);
+		VisibleSectorStarts.push_back(start);
+	}
+
+	// fills the visible lists from the set bits of the PVS row for the subsector the view is in, and the box around what is visible
+	// false when there is no row to cull with
+	static bool FindVisible(const WADFile::LevelMap& map, Vector3 viewPosition, WADData::QuadTree::Bounds& visibleBox)
+	{
+		if (!map.PVS || !map.GLSubSectors)
+			return false;
+
+		size_t viewSubSector = map.GetSubSectorFromPoint(viewPosition.x, viewPosition.y);
+		if (viewSubSector == size_t(-1) || !map.PVS->GetVisibleSubSectors(viewSubSector))
+			return false;
+
+		map.PVS->GetVisibleSubSectors(viewSubSector, VisibleSubSectors);
+
+		auto sectorOf = [&](size_t subSector) { return subSector < map.SubSectorPlaces.size() ? map.SubSectorPlaces[subSector].Sector : uint32_t(-1); };
+
+		size_t kept = 0;
+		for (size_t subSector : VisibleSubSectors)
+		{
+			if (sectorOf(subSector) >= map.SectorCache.size())
+				continue;
+
+			VisibleSubSectors[kept++] = subSector;
+
+			const auto& glSubSector = map.GLSubSectors->Contents[subSector];
+			for (size_t index = glSubSector.StartSegment; index < glSubSector.StartSegment + glSubSector.Count; index++)
+			{
+				Vector2 point = map.Vertices.Get(map.GLSegStarts[index]);
+				visibleBox.Add(WADData::QuadTree::Bounds{ point.x, point.y, point.x, point.y });
+			}
+		}
+		VisibleSubSectors.resize(kept);
+
+		// grouped by sector in the order the sector holds them, so each sector's textures are bound once
+		std::sort(VisibleSubSectors.begin(), VisibleSubSectors.end(), [&](size_t a, size_t b)
+		{
+			if (sectorOf(a) != sectorOf(b))
+				return sectorOf(a) < sectorOf(b);
+			return map.SubSectorPlaces[a].Slot < map.SubSectorPlaces[b].Slot;
+		});
+
+		for (size_t i = 0; i < VisibleSubSectors.size(); i++)
+		{
+			uint32_t sectorIndex = sectorOf(VisibleSubSectors[i]);
+			if (VisibleSectors.empty() || VisibleSectors.back() != sectorIndex)
+				AddVisibleSector(sectorIndex, i);
+		}
+
+		return true;
+	}
+
+	void DrawMap3d(const WADFile::LevelMap& map, Vector3 viewPosition)
 	{
-		for (const auto& sector : map.SectorCache)
+		NextFrameStamp(map);
+
+		VisibleSubSectors.clear();
+		VisibleSectors.clear();
+		VisibleSectorStarts.clear();
+
+		WADData::QuadTree::Bounds visibleBox;
+		bool culled = FindVisible(map, viewPosition, visibleBox);
+		if (!culled)
 		{
-			auto& rawSector = map.Sectors->Contents[sector.SectorIndex];
+			for (size_t sectorIndex = 0; sectorIndex < map.SectorCache.size(); sectorIndex++)
+			{
+				AddVisibleSector(uint32_t(sectorIndex), VisibleSubSectors.size());
+				const auto& subSectors = map.SectorCache[sectorIndex].SubSectors;
+				VisibleSubSectors.insert(VisibleSubSectors.end(), subSectors.begin(), subSectors.end());
+			}
+		}
+		VisibleSectorStarts.push_back(VisibleSubSectors.size());
+
+		for (size_t visibleIndex = 0; visibleIndex < VisibleSectors.size(); visibleIndex++)
+		{
+			size_t sectorIndex = VisibleSectors[visibleIndex];
+			auto& rawSector = map.Sectors->Contents[sectorIndex];
 			Texture2D floor = GetFlat(rawSector.FloorTexture, map.SourceWad);
 			rlSetTexture(floor.id);
 
@@ -191,21 +321,19 @@ namespace DoomRender
 			rlColor4f(1, 1, 1, 1);
 			rlNormal3f(0, 0, 1);
 
-			for (size_t subsectorIndex : sector.SubSectors)
+			for (size_t i = VisibleSectorStarts[visibleIndex]; i < VisibleSectorStarts[visibleIndex + 1]; i++)
 			{
-				const auto& glSubSector = map.GLSubSectors->Contents[subsectorIndex];
+				const auto& glSubSector = map.GLSubSectors->Contents[VisibleSubSectors[i]];
 
 				float lightLevel = (rawSector.LightLevel / 255.0f) * 0.75f;
 				rlColor4f(lightLevel, lightLevel, lightLevel, 1);
 
-				Vector2 origin = map.GetVertex(map.GLSegs->Contents[glSubSector.StartSegment].Start, map.GLSegs->Contents[glSubSector.StartSegment].StartIsGL);
+				Vector2 origin = map.Vertices.Get(map.GLSegStarts[glSubSector.StartSegment]);
 
 				for (size_t index = glSubSector.StartSegment + 1; index < glSubSector.StartSegment + glSubSector.Count; index++)
 				{
-					const auto& segment = map.GLSegs->Contents[index];
-
-					Vector2 sp = map.GetVertex(segment.Start, segment.StartIsGL);
-					Vector2 ep = map.GetVertex(segment.End, segment.EndIsGL);
+					Vector2 sp = map.Vertices.Get(map.GLSegStarts[index]);
+					Vector2 ep = map.Vertices.Get(map.GLSegEnds[index]);
 
 					rlTexCoord2f(ep.x / 2.0f, ep.y / 2.0f);
 					rlVertex3f(ep.x, ep.y, rawSector.Floor);
@@ -230,21 +358,19 @@ namespace DoomRender
 			rlColor4f(1, 1, 1, 1);
 			rlNormal3f(0, 0, 1);
 
-			for (size_t subsectorIndex : sector.SubSectors)
+			for (size_t i = VisibleSectorStarts[visibleIndex]; i < VisibleSectorStarts[visibleIndex + 1]; i++)
 			{
-				const auto& glSubSector = map.GLSubSectors->Contents[subsectorIndex];
+				const auto& glSubSector = map.GLSubSectors->Contents[VisibleSubSectors[i]];
 
 				float lightLevel = rawSector.LightLevel / 255.0f;
 				rlColor4f(lightLevel, lightLevel, lightLevel, 1);
 
-				Vector2 origin = map.GetVertex(map.GLSegs->Contents[glSubSector.StartSegment].Start, map.GLSegs->Contents[glSubSector.StartSegment].StartIsGL);
+				Vector2 origin = map.Vertices.Get(map.GLSegStarts[glSubSector.StartSegment]);
 
 				for (size_t index = glSubSector.StartSegment + 1; index < glSubSector.StartSegment + glSubSector.Count; index++)
 				{
-					const auto& segment = map.GLSegs->Contents[index];
-
-					Vector2 sp = map.GetVertex(segment.Start, segment.StartIsGL);
-					Vector2 ep = map.GetVertex(segment.End, segment.EndIsGL);
+					Vector2 sp = map.Vertices.Get(map.GLSegStarts[index]);
+					Vector2 ep = map.Vertices.Get(map.GLSegEnds[index]);
 
 					rlTexCoord2f(origin.x / 2.0f, origin.y / 2.0f);
 					rlVertex3f(origin.x, origin.y, rawSector.Ceiling);
@@ -264,22 +390,40 @@ namespace DoomRender
 			rlSetTexture(0);
 		}
 
-		for (const auto& thing : map.Things->Contents)
+		auto drawThing = [&](const WADData::ThingsLump::Thing& thing)
 		{
 			float floor = 0;
-			if (thing.SectorId != size_t(-1))
+			if (thing.SectorId < map.Sectors->Contents.size())
 				floor = map.Sectors->Contents[thing.SectorId].Floor;
 			DrawSphere(Vector3{ thing.Position.x, thing.Position.y, floor + 0.5f }, 0.125f, ColorAlpha(YELLOW, 0.25f));
+		};
+
+		if (culled)
+		{
+			// only the things inside the box around what is visible are looked at
+			map.ThingTree.ForEachInBox(visibleBox, [&](uint32_t thingIndex)
+			{
+				const auto& thing = map.Things->Contents[thingIndex];
+				if (thing.SectorId >= SectorStamps.size() || SectorStamps[thing.SectorId] == FrameStamp)
+					drawThing(thing);
+				return true;
+			});
 		}
-		
-		for (const auto& sector : map.SectorCache)
+		else if (map.Things)
+		{
+			for (const auto& thing : map.Things->Contents)
+				drawThing(thing);
+		}
+
+		for (uint32_t sectorIndex : VisibleSectors)
 		{
+			const auto& sector = map.SectorCache[sectorIndex];
 			for (const auto& edge : sector.Edges)
 			{
-				const auto& line = map.Lines->Contents[edge.Line];
+				const auto line = map.Lines->Contents[edge.Line];
 
-				auto sp = map.Verts->Contents[line.Start].Position;
-				auto ep = map.Verts->Contents[line.End].Position;
+				auto sp = map.Vertices.Get(line.Start);
+				auto ep = map.Vertices.Get(line.End);
 
 				float floor = map.Sectors->Contents[sector.SectorIndex].Floor;
 				float ceiling = map.Sectors->Contents[sector.SectorIndex].Ceiling;
@@ -66,7 +66,7 @@ void VisualizeLineDefs(WADData::LineDefLump* lineDefs, WADFile::LevelMap* map)
 
         if (CurrentLine >= 0)
         {
-            const auto& line = lineDefs->Contents[CurrentLine];
+            const auto line = lineDefs->Contents[CurrentLine];
 
             ImGui::Text("SP %d, EP %d", line.Start, line.End);
             ImGui::Text("Front %d, Back %d", line.FrontSideDef, line.BackSideDef);
@@ -83,7 +83,10 @@ void VisualizeSideDefs(WADData::SideDefLump* sideDefs, WADFile::LevelMap* map)
         int count = 0;
         for (const auto& side : sideDefs->Contents)
         {
-            const char* text = TextFormat("SectorId %d T %s M %s B %s ##Side%d", side.SectorId, side.TopTexture.c_str(), side.MidTexture.c_str(), side.LowerTexture.c_str(), count);
+            const char* text = TextFormat("SectorId %d T %s M %s B %s ##Side%d", side.SectorId,
+                map->SourceWad.TextureNames.GetName(side.TopTexture).ToString().c_str(),
+                map->SourceWad.TextureNames.GetName(side.MidTexture).ToString().c_str(),
+                map->SourceWad.TextureNames.GetName(side.LowerTexture).ToString().c_str(), count);
             if (ImGui::Selectable(text))
             {
             }
@@ -105,7 +108,8 @@ void VisualizeSectors(WADData::SectorsLump* sectorDefs, WADFile::LevelMap* map)
 		for (const auto& sector : sectorDefs->Contents)
 		{
             bool selected = CurrentSector == count;
-			const char* text = TextFormat("S %d, F %d C %d FT %s CT %s###Sector%d", count, sector.FloorHeight, sector.CeilingHeight, sector.FloorTexture.c_str(), sector.CeilingTexture.c_str(), count);
+			const char* text = TextFormat("S %d, F %d C %d FT %s CT %s###Sector%d", count, sector.FloorHeight, sector.CeilingHeight,
+                map->SourceWad.FlatNames.GetName(sector.FloorTexture).ToString().c_str(), map->SourceWad.FlatNames.GetName(sector.CeilingTexture).ToString().c_str(), count);
 			if (ImGui::Selectable(text, selected))
 			{
                 CurrentSector = count;
@@ -122,7 +126,7 @@ void VisualizeSectors(WADData::SectorsLump* sectorDefs, WADFile::LevelMap* map)
         int count = 0;
         for (auto& edge : sector.Edges)
         {
-            const auto& line = map->Lines->Contents[edge.Line];
+            const auto line = map->Lines->Contents[edge.Line];
 
 			ImGui::Text("Edge %d SP %d, EP %d, Dest %d", count, line.Start, line.End, edge.Destination);
 			ImGui::Text("        Front %d, Back %d", line.FrontSideDef, line.BackSideDef);
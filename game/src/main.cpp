@@ -7,6 +7,8 @@ Doom Level Reader Test
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 #include "raylib.h"
 #include "raymath.h"
@@ -17,6 +19,7 @@ Doom Level Reader Test
 #include "imgui.h"
 
 #include "doom_map.h"
+#include "resource_stack.h"
 #include "doom_map_render.h"
 #include "lump_inspectors.h"
 #include "reader.h"
@@ -25,7 +28,7 @@ Doom Level Reader Test
 WADFile::LevelMap* Map;
 RenderTexture SectorViewRT;
 
-WADFile GameWad;
+ResourceStack GameWad;
 
 Camera2D MapViewCamera = { 0 };
 constexpr float DefaultZoom = 5.0f;
@@ -36,6 +39,10 @@ CameraController Controller;
 size_t SelectedSector = 0;
 size_t SelectedSubsector = 0;
 
+// the linedef nearest the mouse in the 2d view, and the last one clicked
+size_t HoveredLine = size_t(-1);
+size_t SelectedLine = size_t(-1);
+
 bool View3D = false;
 
 void SetCameraToSpawn()
@@ -51,6 +58,8 @@ void ShowLevelInfoWindow()
     if (ImGui::Begin("Map Info") && Map)
     {
 		ImGui::TextUnformatted(Map->Name.c_str());
+		if (SelectedLine != size_t(-1))
+			ImGui::Text("Line %d", int(SelectedLine));
 
 		ImGui::TextUnformatted("Sectors");
 		if (ImGui::BeginListBox("##Sectors", ImVec2(-FLT_MIN, 5 * ImGui::GetTextLineHeightWithSpacing())))
@@ -96,8 +105,10 @@ void LoadMap()
 {
     SelectedSector = 0;
     SelectedSubsector = 0;
+    HoveredLine = size_t(-1);
+    SelectedLine = size_t(-1);
 
-    if (Map->Verts == nullptr)
+    if (!Map->IsLoaded())
         Map->Load();
 
     SetupLumpInspector(WADData::THINGS, Map->Things);
@@ -181,7 +192,12 @@ void DrawMapView()
 	DrawLine(-1, 0, 2, 0, RED);
 	DrawLine(0, -1, 0, 2, GREEN);
 
-	DoomRender::DrawMapSegs(*Map, SelectedSector, SelectedSubsector);
+	// the render texture is upside down, so the corners of the screen are found in its space
+	Vector2 viewMin = GetScreenToWorld2D(Vector2{ 0, 0 }, MapViewCamera);
+	Vector2 viewMax = GetScreenToWorld2D(Vector2{ float(GetScreenWidth()), float(GetScreenHeight()) }, MapViewCamera);
+	Rectangle view = { std::min(viewMin.x, viewMax.x), std::min(viewMin.y, viewMax.y), std::abs(viewMax.x - viewMin.x), std::abs(viewMax.y - viewMin.y) };
+
+	DoomRender::DrawMapSegs(*Map, SelectedSector, SelectedSubsector, view, HoveredLine, SelectedLine);
 
 	EndMode2D();
 
@@ -198,7 +214,7 @@ void Draw3DView()
 
 	BeginMode3D(ViewCamera);
 	DrawCube(Vector3Zero(), 1, 1, 1, RED);
-	DoomRender::DrawMap3d(*Map);
+	DoomRender::DrawMap3d(*Map, ViewCamera.position);
 	EndMode3D();
 }
 
@@ -242,16 +258,21 @@ void UpdateMapInput()
 			Vector2 rtMousePos = { GetMousePosition().x, GetScreenHeight() - GetMousePosition().y };
 			Vector2 worldCamera = GetScreenToWorld2D(rtMousePos, MapViewCamera);
 
+			// lines are picked within a few pixels of the mouse whatever the zoom
+			constexpr float pickPixels = 8;
+			HoveredLine = Map->FindNearestLine(worldCamera, pickPixels / MapViewCamera.zoom);
+
 			if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
 			{
 				SelectedSector = Map->GetSectorFromPoint(worldCamera.x, worldCamera.y, &SelectedSubsector);
+				SelectedLine = HoveredLine;
 			}
 
 		}
 	}
 }
 
-int main ()
+int main (int argc, char* argv[])
 {
 	// set up the window
 	SetConfigFlags(FLAG_WINDOW_RESIZABLE);
@@ -265,7 +286,34 @@ int main ()
 	ViewCamera.up.z = 1;
 	Controller.SetPosition(Vector3{ 0,-2,0 });
 	
-	GameWad.Read("resources/glDOOMWAD.wad");
+	double readStart = GetTime();
+	// GL nodes are built for maps that don't have them, so a plain IWAD works, a GL processed one is still used if that is all there is
+	GameWad.Read("resources/DOOM.WAD");
+	if (!GameWad.GetSource())
+		GameWad.Read("resources/glDOOMWAD.wad");
+	if (GameWad.GetSource())
+		TraceLog(LOG_INFO, "WAD: Read directory in %.2fms (%s)", (GetTime() - readStart) * 1000.0, GameWad.GetSource()->GetName());
+
+	// any PWADs on the command line are mounted over the IWAD
+	if (argc > 1)
+	{
+		std::vector<std::string> pwads(argv + 1, argv + argc);
+
+		double mountStart = GetTime();
+		size_t mounted = GameWad.Mount(pwads);
+		TraceLog(LOG_INFO, "WAD: Mounted %d of %d PWADs in %.2fms", int(mounted), int(pwads.size()), (GetTime() - mountStart) * 1000.0);
+	}
+
+	// post processed levels are baked here, so the next launch can skip that work
+	GameWad.LevelCacheFolder = "resources/baked";
+
+	// floor snapping reads the sector under the player from a grid of 16 unit cells
+	GameWad.SectorGridCellSize = 16;
+
+	// load every level up front on all cores, so switching maps doesn't stall a frame
+	double loadStart = GetTime();
+	GameWad.LoadLevels();
+	TraceLog(LOG_INFO, "WAD: Loaded %d levels in %.2fms", int(GameWad.Levels.size()), (GetTime() - loadStart) * 1000.0);
 
 	if (GameWad.Levels.size() > 0)
 		Map = &GameWad.Levels[0];
@@ -0,0 +1,189 @@
+#include "map_collision.h"
+
+#include "raymath.h"
+
+#include <cmath>
+
+// how far a move stops short of what it hit, so the next sweep doesn't start out touching it
+static constexpr float Skin = 1.0f / 4096.0f;
+
+// the earliest time before time that a circle moving from point along delta touches the segment from start to end
+// time and normal are updated when it does, the normal points back toward where the circle came from
+static bool SweepCircle(Vector2 point, Vector2 delta, float radius, Vector2 start, Vector2 end, float& time, Vector2& normal)
+{
+	bool hit = false;
+
+	// the side of the line, the circle touches it when its centre is radius away
+	Vector2 edge = Vector2Subtract(end, start);
+	float edgeLengthSquared = Vector2LengthSqr(edge);
+	if (edgeLengthSquared > 0)
+	{
+		Vector2 lineNormal = Vector2Scale(Vector2{ -edge.y, edge.x }, 1.0f / std::sqrt(edgeLengthSquared));
+		float distance = Vector2DotProduct(Vector2Subtract(point, start), lineNormal);
+		if (distance < 0)
+		{
+			lineNormal = Vector2Negate(lineNormal);
+			distance = -distance;
+		}
+
+		float approach = Vector2DotProduct(delta, lineNormal);
+		if (approach < 0)
+		{
+			// a circle that already overlaps the line can move away from it but not further in
+			float t = std::max((distance - radius) / -approach, 0.0f);
+			if (t < time)
+			{
+				Vector2 centre = Vector2Add(point, Vector2Scale(delta, t));
+				float along = Vector2DotProduct(Vector2Subtract(centre, start), edge) / edgeLengthSquared;
+				if (along >= 0 && along <= 1)
+				{
+					time = t;
+					normal = lineNormal;
+					hit = true;
+				}
+			}
+		}
+	}
+
+	// the ends of the line, where the circle can catch on a corner
+	for (Vector2 corner : { start, end })
+	{
+		Vector2 offset = Vector2Subtract(point, corner);
+		float b = Vector2DotProduct(offset, delta);
+		if (b >= 0)
+			continue;
+
+		float c = Vector2LengthSqr(offset) - radius * radius;
+		float a = Vector2LengthSqr(delta);
+
+		float t = 0;
+		if (c > 0)
+		{
+			float discriminant = b * b - a * c;
+			if (discriminant < 0)
+				continue;
+			t = (-b - std::sqrt(discriminant)) / a;
+		}
+
+		if (t >= time)
+			continue;
+
+		Vector2 away = Vector2Subtract(Vector2Add(point, Vector2Scale(delta, t)), corner);
+		float awayLength = Vector2Length(away);
+		if (awayLength <= 0)
+			continue;
+
+		time = t;
+		normal = Vector2Scale(away, 1.0f / awayLength);
+		hit = true;
+	}
+
+	return hit;
+}
+
+bool MapCollider::IsBlocking(const WADFile::LevelMap& map, size_t lineIndex, float z) const
+{
+	const auto line = map.Lines->Contents[lineIndex];
+	if (line.Flags & WADData::LineDefLump::LineDef::ImpassableFlag)
+		return true;
+
+	auto sectorOf = [&](uint16_t side)
+	{
+		if (side == WADData::InvalidSideDefIndex || side >= map.Sides->Contents.size())
+			return size_t(-1);
+
+		size_t sector = map.Sides->Contents[side].SectorId;
+		return sector < map.Sectors->Contents.size() ? sector : size_t(-1);
+	};
+
+	size_t front = sectorOf(line.FrontSideDef);
+	size_t back = sectorOf(line.BackSideDef);
+	if (front == size_t(-1) || back == size_t(-1))
+		return true;
+
+	const auto& frontSector = map.Sectors->Contents[front];
+	const auto& backSector = map.Sectors->Contents[back];
+
+	float openingFloor = std::max(frontSector.Floor, backSector.Floor);
+	float openingCeiling = std::min(frontSector.Ceiling, backSector.Ceiling);
+
+	// the same tests Doom makes, the gap has to fit the height and the step up can't be too tall
+	return openingCeiling - openingFloor < Height || openingCeiling - z < Height || openingFloor - z > StepHeight;
+}
+
+MapCollider::MoveResult MapCollider::Move(const WADFile::LevelMap& map, Vector3 position, Vector2 delta)
+{
+	MoveResult result;
+	result.Position = position;
+
+	float length = Vector2Length(delta);
+	if (!(length > 0))
+		return result;
+
+	if (length > MaxMoveDistance)
+	{
+		delta = Vector2Scale(delta, MaxMoveDistance / length);
+		length = MaxMoveDistance;
+	}
+
+	Vector2 point = { position.x, position.y };
+
+	if (!map.Lines || !map.Sides || !map.Sectors)
+	{
+		point = Vector2Add(point, delta);
+		result.Position = Vector3{ point.x, point.y, position.z };
+		return result;
+	}
+
+	// sliding never takes the circle further from where it started than the move is long, so one query covers every slide
+	float reach = length + Radius + Skin;
+	WADData::QuadTree::Bounds box = { point.x - reach, point.y - reach, point.x + reach, point.y + reach };
+
+	Candidates.clear();
+	map.LineTree.ForEachInBox(box, [&](uint32_t line)
+	{
+		if (IsBlocking(map, line, position.z))
+			Candidates.push_back(line);
+		return true;
+	});
+
+	Vector2 remaining = delta;
+	Vector2 lastNormal = { 0 };
+
+	for (int slide = 0; slide <= MaxSlides && Vector2LengthSqr(remaining) > 0; slide++)
+	{
+		float time = 1;
+		Vector2 normal = { 0 };
+		size_t hitLine = size_t(-1);
+
+		for (uint32_t lineIndex : Candidates)
+		{
+			const auto line = map.Lines->Contents[lineIndex];
+			if (SweepCircle(point, remaining, Radius, map.Vertices.Get(line.Start), map.Vertices.Get(line.End), time, normal))
+				hitLine = lineIndex;
+		}
+
+		if (hitLine == size_t(-1))
+		{
+			point = Vector2Add(point, remaining);
+			break;
+		}
+
+		result.BlockingLine = hitLine;
+
+		point = Vector2Add(Vector2Add(point, Vector2Scale(remaining, time)), Vector2Scale(normal, Skin));
+
+		// what is left of the move goes along the wall
+		remaining = Vector2Scale(remaining, 1 - time);
+		remaining = Vector2Subtract(remaining, Vector2Scale(normal, Vector2DotProduct(remaining, normal)));
+
+		// sliding along this wall would go back into the last one, so the circle is in a corner and stays there
+		if (Vector2DotProduct(remaining, lastNormal) < 0)
+			break;
+
+		lastNormal = normal;
+	}
+
+	result.Position = Vector3{ point.x, point.y, position.z };
+	return result;
+}
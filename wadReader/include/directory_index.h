@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "lump_types.h"
+#include "span.h"
+#include "wad_name.h"
+
+namespace WADData
+{
+    // The marker delimited sections of a WAD directory, lumps with the same name in different namespaces don't replace each other
+    enum class LumpNamespace : uint8_t
+    {
+        Global = 0,
+        Flats,      // F_START/F_END, FF_START/FF_END
+        Patches,    // P_START/P_END, PP_START/PP_END
+        Sprites,    // S_START/S_END, SS_START/SS_END
+        Count,
+    };
+
+    // An index over every entry in a directory, duplicates included.
+    // Entries are grouped by namespace, so each namespace is one contiguous range in file order.
+    // Lookups by name resolve to the last entry with that name in the namespace, the same way the engine resolves them.
+    class DirectoryIndex
+    {
+    public:
+        static constexpr uint32_t InvalidIndex = uint32_t(-1);
+
+        // entries from more than one archive can be indexed at once, later entries win
+        // namespaces are closed at the end of each archive, so an unbalanced marker can't leak into the next one
+        void Build(const std::vector<DirectoryEntry>& entries);
+        void Clear();
+
+        const DirectoryEntry* Find(LumpNamespace space, WadName name) const;
+        const DirectoryEntry* Find(WadName name) const { return Find(LumpNamespace::Global, name); }
+
+        // the index into GetEntries of the winning entry, or InvalidIndex
+        uint32_t FindIndex(LumpNamespace space, WadName name) const;
+
+        // the entry with the same name and namespace that the given entry replaced, or InvalidIndex
+        uint32_t GetReplacedIndex(uint32_t index) const { return Replaced[index]; }
+
+        // every entry of a namespace, in file order
+        Span<const DirectoryEntry> GetNamespace(LumpNamespace space) const;
+
+        // every entry, grouped by namespace
+        const std::vector<DirectoryEntry>& GetEntries() const { return Entries; }
+
+        LumpNamespace GetNamespaceOf(uint32_t index) const;
+
+        size_t size() const { return Entries.size(); }
+
+    protected:
+        struct Range
+        {
+            uint32_t Start = 0;
+            uint32_t Count = 0;
+        };
+
+        std::vector<DirectoryEntry> Entries;
+        std::vector<uint32_t> Replaced;
+
+        Range Ranges[size_t(LumpNamespace::Count)];
+        WadNameMap<uint32_t> Lookup[size_t(LumpNamespace::Count)];
+    };
+}
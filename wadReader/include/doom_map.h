@@ -4,11 +4,17 @@
 #include "raylib.h"
 
 #include <string>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <unordered_map>
 
 #include "reader.h"
+#include "lump_source.h"
+#include "directory_index.h"
+#include "vertex_table.h"
+#include "sector_grid.h"
+#include "quad_tree.h"
 
 class WADFile
 {
@@ -16,51 +22,168 @@ public:
 
     uint8_t* BufferData = nullptr;
 
-    std::unordered_map<std::string, WADData::DirectoryEntry> Entries;
+	// how the archive is stored, mapped files are paged in when first touched
+	// if the file can't be mapped the whole file is loaded with LoadFileData
+	WADReader::LumpSourceType SourceType = WADReader::LumpSourceType::Mapped;
 
+	// the most raw lump bytes a streamed archive keeps in memory
+	size_t StreamingBudget = WADReader::StreamingLumpSource::DefaultResidentBudget;
+
+	// where baked levels are read from and written to, empty turns level baking off
+	std::string LevelCacheFolder;
+
+	// levels with no REJECT, or one that rejects nothing, get one made from which sectors are joined by two sided lines
+	bool GenerateReject = false;
+
+	// the cell size in map units of the sector grid each level builds, 0 leaves the grids out
+	float SectorGridCellSize = 0;
+
+	// every lump in every mounted archive, by namespace, later archives win
+	WADData::DirectoryIndex Directory;
+
+	// Parses lumps the first time they are asked for, lumps that are never used are never read
 	class LumpDatabase
 	{
 	public:
 		template<class T>
-		T* GetLump(const std::string& name)
+		T* GetLump(WADData::WadName name)
 		{
-			auto itr = Lumps.find(name);
-			if (itr == Lumps.end())
+			// asking for the wrong type is a null, before and after the lump has been parsed
+			if (!WADData::IsLumpType<T>(name))
+				return nullptr;
+
+			auto* lump = Lumps.Find(name);
+			if (lump && *lump)
+				return static_cast<T*>(*lump);
+
+			auto* entry = Entries.Find(name);
+			if (!entry)
 				return nullptr;
 
-			return (T*)(itr->second);
+			return static_cast<T*>(LoadLumpData(*entry));
 		}
 
-		void LoadLumpData(const WADData::DirectoryEntry& entry);
+		// makes a lump available to GetLump, a later entry with the same name replaces an earlier one, even if it was already parsed
+		void AddEntry(const WADData::DirectoryEntry& entry);
+
+		bool HasEntry(WADData::WadName name) const { return Entries.Contains(name); }
+
+		// parses a lump now, if it has not already been parsed
+		WADData::Lump* LoadLumpData(const WADData::DirectoryEntry& entry);
+
+		// parses an entry with a type picked by the caller, for lumps whose format depends on their contents, GetLump finds it under key
+		template<class T>
+		T* LoadLumpDataAs(const WADData::DirectoryEntry& entry, WADData::WadName key)
+		{
+			if (!WADData::IsLumpType<T>(key))
+				return nullptr;
+
+			auto* lump = Lumps.Find(key);
+			if (lump && *lump)
+				return static_cast<T*>(*lump);
+
+			return static_cast<T*>(ParseLump(entry, new T(), key));
+		}
+
+		// stores a lump that wasn't parsed from an entry, such as nodes built at load time, GetLump finds it under key
+		// a lump that isn't the type registered for key is freed and not stored, so GetLump can trust what it finds
+		template<class T>
+		T* AddLump(WADData::WadName key, T* lump)
+		{
+			if (!WADData::IsLumpType<T>(key))
+			{
+				delete lump;
+				return nullptr;
+			}
+
+			Lumps.Insert(key, lump);
+			return lump;
+		}
+
+		// where sidedefs and sectors parsed by this database intern their texture names
+		void SetNameTables(WADData::NameTable* textureNames, WADData::NameTable* flatNames)
+		{
+			TextureNames = textureNames;
+			FlatNames = flatNames;
+		}
 
 	protected:
-		std::unordered_map<std::string, WADData::Lump*> Lumps;
+		WADData::Lump* ParseLump(const WADData::DirectoryEntry& entry, WADData::Lump* lump, WADData::WadName key);
+
+		WADData::NameTable* TextureNames = nullptr;
+		WADData::NameTable* FlatNames = nullptr;
+
+		WADData::WadNameMap<WADData::DirectoryEntry> Entries;
+		WADData::WadNameMap<WADData::Lump*> Lumps;
 	};
 
 	LumpDatabase LumpDB;
 
     virtual ~WADFile()
     {
-        if (BufferData)
-            UnloadFileData(BufferData);
+		CloseFile();
     }
 
+	// replaces everything with a single archive
 	virtual void Read(const char* fileName);
 
-	WADData::PlayPalLump* PalettesLump = nullptr;
+	// the first archive that was mounted
+	WADReader::LumpSource* GetSource() const { return Sources.empty() ? nullptr : Sources.front().get(); }
 
-	WADData::PatchNamesLump* PatchNames = nullptr;
+	// the shared lumps are parsed on first use, these are safe to call from levels loading on other threads
+	WADData::PlayPalLump* GetPalettes()
+	{
+		std::lock_guard<std::recursive_mutex> lock(LumpLock);
+		return LumpDB.GetLump<WADData::PlayPalLump>(WADData::PLAYPAL);
+	}
 
-	std::vector<WADData::TexturesLump*> TextureLumps;
+	WADData::PatchNamesLump* GetPatchNames()
+	{
+		std::lock_guard<std::recursive_mutex> lock(LumpLock);
+		return LumpDB.GetLump<WADData::PatchNamesLump>(WADData::PNAMES);
+	}
+
+	// TEXTURE, TEXTURE1 and TEXTURE2, later groups override earlier ones
+	const std::vector<WADData::TexturesLump*>& GetTextureLumps();
+
+	// looks a texture up in every texture group at once
+	WADData::TexturesLump::TextureDef* FindTexture(WADData::WadName name);
+
+	class LevelMap;
+
+	// Follows a point that moves a little at a time, such as the viewer or a thing.
+	// The last subsector and the ones that share a seg with it are checked first, a full lookup only happens when the point went further than that.
+	class SectorTracker
+	{
+	public:
+		// the sector holding the point, size_t(-1) outside the map
+		size_t Update(const LevelMap& map, Vector2 point);
+
+		// forgets the last subsector, the next update does a full lookup
+		void Reset()
+		{
+			Map = nullptr;
+			SubSector = size_t(-1);
+			Sector = size_t(-1);
+		}
+
+		size_t GetSector() const { return Sector; }
+		size_t GetSubSector() const { return SubSector; }
+
+	protected:
+		const LevelMap* Map = nullptr;
+		size_t SubSector = size_t(-1);
+		size_t Sector = size_t(-1);
+	};
 
 	class LevelMap
 	{
 	public:
-		LevelMap(WADFile& source) : SourceWad(source) {};
+		LevelMap(WADFile& source) : SourceWad(source) { LumpDB.SetNameTables(&source.TextureNames, &source.FlatNames); };
 
 		WADFile& SourceWad;
 		std::string Name;
-		std::unordered_map<std::string, WADData::DirectoryEntry> Entries;
+		WADData::WadNameMap<WADData::DirectoryEntry> Entries;
 		LumpDatabase LumpDB;
 
 		WADData::VertexesLump* Verts = nullptr;
@@ -75,6 +198,29 @@ public:
 		WADData::GLVertsLump* GLVerts = nullptr;
 		WADData::GLSegsLump* GLSegs = nullptr;
 		WADData::GLSubSectorsLump* GLSubSectors = nullptr;
+		WADData::GLNodesLump* GLNodes = nullptr;
+
+		// a UDMF map's TEXTMAP, the pointers above point into it when the map has one
+		WADData::UDMFLump* TextMap = nullptr;
+
+		// ZDoom extended nodes, from ZNODES, SSECTORS or NODES, the GL pointers above point into these when the map has no GL lumps
+		WADData::ExtendedNodesLump* ExtendedNodes = nullptr;
+
+		// sector to sector visibility, from REJECT or generated when GenerateReject is set
+		WADData::RejectLump* Reject = nullptr;
+
+		// subsector to subsector visibility from GL_PVS, null when the map has none or it doesn't match the GL subsectors
+		WADData::GLPVSLump* PVS = nullptr;
+
+		// the blockmap, from BLOCKMAP or built when the map has none or it overflowed
+		WADData::BlockMapLump* BlockMap = nullptr;
+
+		// the VERTEXES and GL_VERT vertices together, linedefs index it directly
+		WADData::VertexTable Vertices;
+
+		// the start and end of each GL seg as indexes into Vertices
+		std::vector<uint32_t> GLSegStarts;
+		std::vector<uint32_t> GLSegEnds;
 
 		struct SectorInfo
 		{
@@ -108,22 +254,156 @@ public:
 
 		std::vector<SectorInfo> SectorCache;
 
+		// the GL nodes packed for point lookups, empty when the map's nodes don't lead to GLSubSectors
+		struct LookupNode
+		{
+			Vector2 PartitionStart = { 0 };
+			Vector2 PartitionVector = { 0 };
+
+			// right then left, subsectors are flagged with ExtendedNodesLump::SubSectorChild
+			uint32_t Children[2] = { 0 };
+		};
+		std::vector<LookupNode> LookupNodes;
+
+		// for each GL subsector, the sector holding it and its place in that sector's SubSectors
+		struct SubSectorPlace
+		{
+			uint32_t Sector = uint32_t(-1);
+			uint32_t Slot = 0;
+		};
+		std::vector<SubSectorPlace> SubSectorPlaces;
+
+		// which sector covers each cell, only built when the WAD's SectorGridCellSize is set
+		WADData::SectorGrid SectorGrid;
+
+		// loose quadtrees over the boxes of the linedefs, the GL subsectors and the things, in world units, items are known by their index
+		WADData::QuadTree LineTree;
+		WADData::QuadTree SubSectorTree;
+		WADData::QuadTree ThingTree;
+
+		// the subsectors that share a seg with each subsector, Neighbours[NeighbourStarts[i]] up to NeighbourStarts[i + 1]
+		std::vector<uint32_t> SubSectorNeighbourStarts;
+		std::vector<uint32_t> SubSectorNeighbours;
+
+		// one tracker per thing, MoveThing keeps SectorId up to date with them
+		std::vector<SectorTracker> ThingTrackers;
+
 		std::set<size_t> LeafNodes;
 
-		void Load();
+		// building GL nodes for a map without them and finding the things' sectors use workerCount threads (0 uses one per core)
+		void Load(size_t workerCount = 0);
+		bool IsLoaded() const { return Loaded; }
 
-		Vector2 GetVertex(size_t index, bool isGLVert) const;
+		// composes the flats and textures the level's sectors and sides use into the WAD's image caches, Load does this
+		void CacheImages();
+
+		Vector2 GetVertex(size_t index, bool isGLVert) const { return Vertices.Get(Vertices.GetIndex(index, isGLVert)); }
 
 		size_t GetSectorFromPoint(float x, float y, size_t* subSector = nullptr) const;
 
-		WADData::TexturesLump::TextureDef* FindTexture(const std::string& name);
+		// the index into GLSubSectors of the subsector holding the point, size_t(-1) outside the map
+		size_t GetSubSectorFromPoint(float x, float y) const;
+
+		// true when the point is inside the GL subsector or on one of its segs
+		bool SubSectorContains(size_t subSectorID, Vector2 point) const;
+
+		// the sector from the sector grid in one read, false when there is no grid or an edge crosses the point's cell
+		bool GetSectorFromGrid(float x, float y, size_t& sector) const
+		{
+			uint16_t cell = SectorGrid.Get(x, y);
+			if (!SectorGrid.IsBuilt() || cell == WADData::SectorGrid::Mixed)
+				return false;
+
+			sector = cell == WADData::SectorGrid::Outside ? size_t(-1) : size_t(cell);
+			return true;
+		}
+
+		// GetSectorFromPoint for many points, outSectors[i] gets the sector holding points[i] and must be as long as points
+		// big batches are grouped by area so nearby points share cached nodes, and split across workerCount threads (0 for one per core)
+		void GetSectorsFromPoints(WADData::Span<const Vector2> points, WADData::Span<size_t> outSectors, size_t workerCount = 0) const;
+
+		// true when the PVS says the subsector may be seen from another, or when there is no PVS to ask
+		bool IsSubSectorVisible(size_t from, size_t to) const { return !PVS || PVS->IsSubSectorVisible(from, to); }
+
+		// O(1), line of sight checks should ask this before doing any geometry
+		bool CanSectorsSee(size_t from, size_t to) const { return !Reject || Reject->CanSectorsSee(from, to); }
+
+		// calls visit once for each linedef in a block the box touches, visit returns false to stop early
+		bool ForEachLineInBox(const Rectangle& box, const std::function<bool(size_t lineIndex)>& visit) const;
+
+		// the same for the blocks a segment crosses, in the order it crosses them
+		bool ForEachLineAlongSegment(Vector2 start, Vector2 end, const std::function<bool(size_t lineIndex)>& visit) const;
+
+		// the linedefs nearest a point, closest first and by their real distance, up to out.size() of them within maxDistance
+		size_t FindNearestLines(Vector2 point, float maxDistance, WADData::Span<WADData::QuadTree::Neighbour> out) const;
+
+		// the nearest linedef within maxDistance, size_t(-1) when there is none
+		size_t FindNearestLine(Vector2 point, float maxDistance, float* distance = nullptr) const;
+
+		// what a ray hit first, Type is None when it got to its end or the edge of the map without hitting anything
+		struct RayHit
+		{
+			enum class HitType
+			{
+				None,
+				Wall,
+				Floor,
+				Ceiling,
+			};
+
+			HitType Type = HitType::None;
+
+			// the linedef hit, for walls
+			size_t Line = size_t(-1);
+
+			// the sector whose floor or ceiling was hit, or the one the ray was in when it hit a wall
+			size_t Sector = size_t(-1);
+
+			// where the ray stopped, Position.z is the height it hit at
+			Vector3 Position = { 0 };
+			float Distance = 0;
+		};
+
+		// follows a ray through the blockmap to the first one sided linedef, opening between two sectors it doesn't fit through, floor or ceiling
+		// direction doesn't need to be normalized, distances are along it in world units
+		RayHit RayCast(Vector3 origin, Vector3 direction, float maxDistance = INFINITY) const;
+
+		// RayCast for many rays, split across workerCount threads (0 for one per core), outHits[i] gets the hit for rays[i] and must be as long as rays
+		void RayCasts(WADData::Span<const Ray> rays, WADData::Span<RayHit> outHits, float maxDistance = INFINITY, size_t workerCount = 0) const;
+
+		// true when nothing blocks the straight line between two points, REJECT is asked before any geometry
+		bool HasLineOfSight(Vector3 from, Vector3 to) const;
+
+		// moves a thing and finds its sector again, starting from the subsector it was last in
+		void MoveThing(size_t thingIndex, Vector2 position);
+
+		WADData::TexturesLump::TextureDef* FindTexture(WADData::WadName name);
 
 	protected:
+		bool Loaded = false;
+
 		void FindLeafs(size_t node);
 
-		void CacheFlat(const std::string& flatName);
-		void CachePatch(const std::string& patchName);
-		void CacheTexture(const std::string& textureName);
+		// the GL subsector holding the point, with the sector and the subsector's place in that sector's list
+		// O(log n) down the GL nodes, maps without usable nodes test every subsector instead
+		size_t FindSubSector(Vector2 point, size_t& sector, size_t& sectorSubSector) const;
+
+		// the walk down LookupNodes, a point right on a partition goes left like it does in the game
+		// untakenChild is set to the child the walk didn't go down at the last partition the point was on,
+		// the leaf can miss a point on the map's edge and then that side of the partition is tried
+		uint32_t StepLookupNode(uint32_t child, Vector2 point, uint32_t& untakenChild) const;
+		uint32_t DescendLookupNodes(uint32_t child, Vector2 point, uint32_t& untakenChild) const;
+		size_t ResolveLookupLeaf(uint32_t leaf, Vector2 point, uint32_t untakenChild) const;
+
+		// fills LookupNodes, SubSectorPlaces and the subsector neighbours, once SectorCache is known
+		void BuildPointLookup();
+
+		// fills LineTree, SubSectorTree and ThingTree
+		void BuildQuadTrees();
+
+		void CacheFlat(uint16_t flatId);
+		void CachePatch(WADData::WadName patchName);
+		void CacheTexture(uint16_t textureId);
 	};
 
 	struct PatchData
@@ -135,8 +415,48 @@ public:
 
 	std::vector<LevelMap> Levels;
 
-	std::unordered_map<std::string, Image> Flats;
-	std::unordered_map<std::string, PatchData> Patches;
-	std::unordered_map<std::string, Image> Textures;
+	LevelMap* FindLevel(WADData::WadName name);
+
+	// loads every level that is not loaded yet, spread over workerCount threads (0 uses one per core)
+	void LoadLevels(size_t workerCount = 0);
+
+	// loads the levels at the given indexes into Levels, each index should only be given once
+	void LoadLevels(const std::vector<size_t>& levelIndexes, size_t workerCount = 0);
+
+	// every texture and flat name used by a loaded level, sidedefs and sectors store IDs from these
+	WADData::NameTable TextureNames;
+	WADData::NameTable FlatNames;
+
+	// composed images indexed by ID, an image with no data has not been cached
+	std::vector<Image> Flats;
+	WADData::WadNameMap<PatchData> Patches;
+	std::vector<Image> Textures;
+
+protected:
+	void CloseFile();
+
+	// adds an archive on top of the ones already mounted, Directory has to be rebuilt afterwards with BuildDirectory
+	bool MountArchive(const char* fileName);
+	void BuildDirectory();
+
+	// the cached images may have come from lumps that a new archive replaced, BuildDirectory composes the loaded levels' images again
+	void ClearImageCaches();
+
+	std::vector<std::unique_ptr<WADReader::LumpSource>> Sources;
+	std::vector<std::string> SourceNames;
+
+	// the directories of every mounted archive, in mount order
+	std::vector<WADData::DirectoryEntry> RawDirectory;
+
+	WADData::WadNameMap<size_t> LevelIndex;
+
+	std::vector<WADData::TexturesLump*> TextureLumps;
+	WADData::WadNameMap<WADData::TexturesLump::TextureDef*> TextureIndex;
+	bool TextureLumpsLoaded = false;
+
+	// guards LumpDB and the texture index, recursive since parsing one lump can ask for another
+	std::recursive_mutex LumpLock;
 
+	// guards Flats, Patches and Textures, images are composed outside the lock and only inserted under it
+	std::mutex ImageCacheLock;
 };
\ No newline at end of file
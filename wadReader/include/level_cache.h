@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "doom_map.h"
+
+namespace WADReader
+{
+    // Baked levels hold everything LevelMap::Load works out from the map lumps, so a level seen before can skip that work.
+    // The blob is a header, a table of chunks, then the chunk data as flat arrays of fixed size records, so it can be mapped and read in place.
+    // Files are named by a hash of the map lumps they were built from, when a lump changes the hash does too and the old file is never used again.
+    static constexpr uint32_t BakedLevelVersion = 2;
+
+    // FNV-1a over the name, size and bytes of every lump in the level
+    uint64_t HashLevelLumps(const WADData::WadNameMap<WADData::DirectoryEntry>& entries);
+
+    std::string GetBakedLevelPath(const char* folder, uint64_t sourceHash, const char* extension = "dlvb");
+
+    // fills the sector cache and thing sectors of a level whose lumps are already loaded, false if there is no valid baked file
+    bool LoadBakedLevel(WADFile::LevelMap& level, const char* folder, uint64_t sourceHash);
+
+    bool SaveBakedLevel(const WADFile::LevelMap& level, const char* folder, uint64_t sourceHash);
+
+    // GL nodes built for a level that had none, stored as an XGL3 lump next to the baked level
+    bool LoadBuiltNodes(WADData::ExtendedNodesLump& nodes, const char* folder, uint64_t sourceHash);
+
+    bool SaveBuiltNodes(const WADData::ExtendedNodesLump& nodes, const char* folder, uint64_t sourceHash);
+}
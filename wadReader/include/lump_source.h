@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "lump_types.h"
+#include "mapped_file.h"
+#include "random_access_file.h"
+
+namespace WADReader
+{
+    enum class LumpSourceType
+    {
+        Heap,       // the whole archive is loaded with LoadFileData
+        Mapped,     // the whole archive is memory mapped and paged in on demand
+        Streamed,   // lumps are read on demand into a bounded cache
+    };
+
+    // Where the bytes of an archive come from.
+    // Every directory entry points back at the source it was read from, so lumps can be fetched without knowing how the archive is stored.
+    class LumpSource
+    {
+    public:
+        virtual ~LumpSource() = default;
+
+        virtual bool Open(const char* fileName) = 0;
+        virtual void Close() = 0;
+
+        virtual const char* GetName() const = 0;
+        virtual size_t GetSize() const = 0;
+
+        // the whole archive if it is addressable, nullptr when lumps are only read on demand
+        virtual uint8_t* GetBuffer() const { return nullptr; }
+
+        // copies a range of the archive into destination
+        virtual bool Read(size_t offset, size_t size, uint8_t* destination);
+
+        // the bytes of a lump, valid until the matching ReleaseLump call
+        virtual uint8_t* AcquireLump(const WADData::DirectoryEntry& entry);
+        virtual void ReleaseLump(const WADData::DirectoryEntry& entry) {}
+    };
+
+    class HeapLumpSource : public LumpSource
+    {
+    public:
+        ~HeapLumpSource() override;
+
+        bool Open(const char* fileName) override;
+        void Close() override;
+
+        const char* GetName() const override { return "heap"; }
+        size_t GetSize() const override { return Size; }
+        uint8_t* GetBuffer() const override { return Data; }
+
+    protected:
+        uint8_t* Data = nullptr;
+        size_t Size = 0;
+    };
+
+    class MappedLumpSource : public LumpSource
+    {
+    public:
+        bool Open(const char* fileName) override { return File.Open(fileName); }
+        void Close() override { File.Close(); }
+
+        const char* GetName() const override { return "mapped"; }
+        size_t GetSize() const override { return File.GetSize(); }
+        uint8_t* GetBuffer() const override { return File.GetData(); }
+
+    protected:
+        MappedFile File;
+    };
+
+    // Reads lumps with positioned reads into a pool of reusable buffers.
+    // Lumps that are not acquired stay cached until the resident bytes go over the budget, then the least recently used ones are evicted.
+    // Acquired lumps are never evicted, so the budget can only be exceeded by lumps that are in use at the same time.
+    class StreamingLumpSource : public LumpSource
+    {
+    public:
+        static constexpr size_t DefaultResidentBudget = 64 * 1024 * 1024;
+
+        StreamingLumpSource(size_t residentBudget = DefaultResidentBudget) : ResidentBudget(residentBudget) {}
+
+        bool Open(const char* fileName) override;
+        void Close() override;
+
+        const char* GetName() const override { return "streamed"; }
+        size_t GetSize() const override { return File.GetSize(); }
+
+        bool Read(size_t offset, size_t size, uint8_t* destination) override;
+
+        uint8_t* AcquireLump(const WADData::DirectoryEntry& entry) override;
+        void ReleaseLump(const WADData::DirectoryEntry& entry) override;
+
+        void SetResidentBudget(size_t budget);
+        size_t GetResidentBudget() const { return ResidentBudget; }
+
+        // bytes held by cached lumps and pooled buffers
+        size_t GetResidentBytes() const { return ResidentBytes; }
+
+    protected:
+        struct Buffer
+        {
+            std::unique_ptr<uint8_t[]> Data;
+            size_t Capacity = 0;
+        };
+
+        struct LumpKey
+        {
+            size_t Offset = 0;
+            size_t Size = 0;
+
+            bool operator==(const LumpKey& other) const { return Offset == other.Offset && Size == other.Size; }
+        };
+
+        struct LumpKeyHash
+        {
+            size_t operator()(const LumpKey& key) const { return std::hash<size_t>()(key.Offset) ^ (std::hash<size_t>()(key.Size) << 1); }
+        };
+
+        struct CachedLump
+        {
+            Buffer Storage;
+            int Pins = 0;
+
+            // position in LeastRecentlyUsed, only valid while the lump is not pinned
+            std::list<LumpKey>::iterator Unused;
+        };
+
+        Buffer TakeBuffer(size_t size);
+        bool HasPooledBuffer(size_t size) const;
+        void EvictLeastRecentlyUsed();
+
+        // evicts unused lumps and frees pooled buffers until the resident bytes fit the budget
+        void TrimTo(size_t budget);
+
+        RandomAccessFile File;
+
+        size_t ResidentBudget = DefaultResidentBudget;
+        size_t ResidentBytes = 0;
+
+        std::mutex Lock;
+        std::unordered_map<LumpKey, CachedLump, LumpKeyHash> Cache;
+        std::list<LumpKey> LeastRecentlyUsed;
+        std::vector<Buffer> Pool;
+    };
+
+    std::unique_ptr<LumpSource> CreateLumpSource(LumpSourceType type, size_t residentBudget = StreamingLumpSource::DefaultResidentBudget);
+
+    // Pins the bytes of a lump for as long as this object lives
+    class LumpData
+    {
+    public:
+        LumpData(const WADData::DirectoryEntry& entry);
+        ~LumpData();
+
+        LumpData(const LumpData&) = delete;
+        LumpData& operator=(const LumpData&) = delete;
+
+        uint8_t* Data = nullptr;
+        size_t Size = 0;
+
+    protected:
+        WADData::DirectoryEntry Entry;
+    };
+}
@@ -2,9 +2,20 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <functional>
+#include <unordered_map>
 
 #include "raylib.h"
+#include "wad_name.h"
+#include "name_table.h"
+#include "record_view.h"
+
+namespace WADReader
+{
+    class LumpSource;
+    class LumpData;
+}
 
 namespace WADData
 {
@@ -14,17 +25,46 @@ namespace WADData
     {
         size_t LumpOffset = 0;
         size_t LumpSize = 0;
-        std::string Name;
+        WadName Name;
 
+        // the whole archive, when it is resident in memory
         uint8_t* BufferData = nullptr;
+
+        // where the lump bytes are read from, use WADReader::LumpData to access them
+        WADReader::LumpSource* Source = nullptr;
+    };
+
+    // What a lump may need from outside its own bytes while it is parsed
+    struct ParseContext
+    {
+        // the format of the level's GL nodes, read from the GL_VERT header
+        int GLVertsVersion = 0;
+
+        // where sidedef textures and sector flats are interned, the IDs are left as None when these are null
+        NameTable* TextureNames = nullptr;
+        NameTable* FlatNames = nullptr;
+
+        // REJECT has no header, its size comes from the level's SECTORS
+        size_t SectorCount = 0;
+
+        // nor does GL_PVS, its size comes from the level's GL_SSECT
+        size_t SubSectorCount = 0;
     };
 
     class Lump
     {
     public:
-        virtual void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) {}
+        virtual void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) {}
 
-        virtual ~Lump() = default;
+        // defined with the lump types, where LumpData is complete
+        Lump();
+        virtual ~Lump();
+
+        // lumps that view their records in place need the bytes they were parsed from to stay resident
+        virtual bool ReadsInPlace() const { return false; }
+
+        // holds the bytes of a lump that reads in place for as long as the lump lives
+        std::unique_ptr<WADReader::LumpData> PinnedData;
 
         std::function<void(Lump*, void*)> Visualize = nullptr;
     };
@@ -46,6 +86,15 @@ namespace WADData
     static constexpr char GL_NODES[]    = "GL_NODES";
     static constexpr char GL_PVS[]      = "GL_PVS";
 
+    static constexpr char ZNODES[]      = "ZNODES";
+
+    // UDMF maps, TEXTMAP holds the map as text and ENDMAP closes it
+    static constexpr char TEXTMAP[]     = "TEXTMAP";
+    static constexpr char ENDMAP[]      = "ENDMAP";
+    static constexpr char BEHAVIOR[]    = "BEHAVIOR";
+    static constexpr char DIALOGUE[]    = "DIALOGUE";
+    static constexpr char SCRIPTS[]     = "SCRIPTS";
+
     static constexpr char PLAYPAL[] = "PLAYPAL";
 
     static constexpr char PNAMES[] = "PNAMES";
@@ -55,12 +104,13 @@ namespace WADData
 
     static constexpr float MapScale = 1.0f / 32.0f;
 
-    Lump* GetLump(const std::string& name);
+    // creates an empty lump of the type registered for the name in LumpTypes, nullptr when the name has no parser
+    Lump* GetLump(WadName name);
 
     class ThingsLump : public Lump
     {
     public:
-        void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
         struct Thing
         {
@@ -87,18 +137,23 @@ namespace WADData
     class VertexesLump : public Lump
     {
     public:
-        void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+        bool ReadsInPlace() const override { return true; }
 
         struct Vertex
         {
             int16_t X = 0;
             int16_t Y = 0;
 
-            Vector2 Position = { 0 };
             static constexpr size_t ReadSize = 4;
+
+            static Vertex Read(const uint8_t* bytes) { return Vertex{ LoadInt16LE(bytes), LoadInt16LE(bytes + 2) }; }
         };
 
-        std::vector<Vertex> Contents;
+        RecordView<Vertex> Contents;
+
+        // the vertices in world units (scaled by MapScale)
+        std::vector<Vector2> Positions;
     };
 
 	static constexpr uint16_t InvalidSectorIndex = uint16_t(-1);
@@ -107,7 +162,9 @@ namespace WADData
     class LineDefLump : public Lump
     {
     public:
-        void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        bool ReadsInPlace() const override { return true; }
 
         struct LineDef
         {
@@ -119,24 +176,34 @@ namespace WADData
             uint16_t FrontSideDef = InvalidSideDefIndex;
             uint16_t BackSideDef = InvalidSideDefIndex;
 
+            // the line stops players and monsters even when it is two sided
+            static constexpr uint16_t ImpassableFlag = 0x0001;
+
             static constexpr size_t ReadSize = 14;
+
+            static LineDef Read(const uint8_t* bytes)
+            {
+                return LineDef{ LoadUInt16LE(bytes), LoadUInt16LE(bytes + 2), LoadUInt16LE(bytes + 4), LoadUInt16LE(bytes + 6),
+                    LoadUInt16LE(bytes + 8), LoadUInt16LE(bytes + 10), LoadUInt16LE(bytes + 12) };
+            }
         };
 
-        std::vector<LineDef> Contents;
+        RecordView<LineDef> Contents;
     };
 
 	class SideDefLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct SideDef
 		{
 			int16_t XOffset = 0;
 			int16_t YOffset = 0;
-            std::string TopTexture;
-            std::string MidTexture;
-            std::string LowerTexture;
+            // IDs in the WAD texture name table
+            uint16_t TopTexture = NameTable::None;
+            uint16_t MidTexture = NameTable::None;
+            uint16_t LowerTexture = NameTable::None;
 			uint16_t SectorId = InvalidSectorIndex;
 
             Vector2 Offset = { 0 };
@@ -150,15 +217,16 @@ namespace WADData
     class SectorsLump : public Lump
     {
     public:
-        void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct Sector
 		{
 			int16_t FloorHeight = 0;
            
 			int16_t CeilingHeight = 0;
-            std::string FloorTexture;
-            std::string CeilingTexture;
+            // IDs in the WAD flat name table
+            uint16_t FloorTexture = NameTable::None;
+            uint16_t CeilingTexture = NameTable::None;
 			int16_t LightLevel = 0;
 			uint16_t SpecialType = 0;
 			uint16_t TagNumber = 0;
@@ -175,7 +243,7 @@ namespace WADData
 	class SegsLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct Seg
 		{
@@ -187,15 +255,23 @@ namespace WADData
             int16_t Offset = 0;
 
 			static constexpr size_t ReadSize = 12;
+
+			static Seg Read(const uint8_t* bytes)
+			{
+				return Seg{ LoadUInt16LE(bytes), LoadUInt16LE(bytes + 2), LoadInt16LE(bytes + 4), LoadUInt16LE(bytes + 6),
+					LoadUInt16LE(bytes + 8), LoadInt16LE(bytes + 10) };
+			}
 		};
 
-		std::vector<Seg> Contents;
+		bool ReadsInPlace() const override { return true; }
+
+		RecordView<Seg> Contents;
 	};
 
     class SubSectorsLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct SubSector
 		{
@@ -203,44 +279,75 @@ namespace WADData
 			uint16_t StartIndex = 0;
 
 			static constexpr size_t ReadSize = 4;
+
+			static SubSector Read(const uint8_t* bytes) { return SubSector{ LoadUInt16LE(bytes), LoadUInt16LE(bytes + 2) }; }
 		};
 
-		std::vector<SubSector> Contents;
+		bool ReadsInPlace() const override { return true; }
+
+		RecordView<SubSector> Contents;
     };
 
 	class NodesLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct Node
 		{
-            Vector2 PartitionStart = { 0 };
-            Vector2 PartitionVector = { 0 };
-
-            Rectangle RightBounds = { 0 };
-            Rectangle LeftBounds = { 0 };
+            int16_t PartitionStartX = 0;
+            int16_t PartitionStartY = 0;
+			int16_t PartitionSlopeX = 0;
+			int16_t PartitionSlopeY = 0;
 
-            int16_t PartitionStartX;
-            int16_t PartitionStartY;
-			int16_t PartitionSlopeX;
-			int16_t PartitionSlopeY;
-            int16_t RightBBox[4];
-            int16_t LeftBBox[4];
+            // top, bottom, left, right
+            int16_t RightBBox[4] = { 0 };
+            int16_t LeftBBox[4] = { 0 };
 
-			uint16_t RightChild;
-			uint16_t LeftChild;
+			uint16_t RightChild = 0;
+			uint16_t LeftChild = 0;
 
 			static constexpr size_t ReadSize = 28;
+
+			static Node Read(const uint8_t* bytes)
+			{
+				Node node;
+				node.PartitionStartX = LoadInt16LE(bytes);
+				node.PartitionStartY = LoadInt16LE(bytes + 2);
+				node.PartitionSlopeX = LoadInt16LE(bytes + 4);
+				node.PartitionSlopeY = LoadInt16LE(bytes + 6);
+				for (int i = 0; i < 4; i++)
+				{
+					node.RightBBox[i] = LoadInt16LE(bytes + 8 + i * 2);
+					node.LeftBBox[i] = LoadInt16LE(bytes + 16 + i * 2);
+				}
+				node.RightChild = LoadUInt16LE(bytes + 24);
+				node.LeftChild = LoadUInt16LE(bytes + 26);
+				return node;
+			}
+
+			// world unit versions of the partition line and child bounds
+			Vector2 GetPartitionStart() const { return Vector2{ PartitionStartX * MapScale, PartitionStartY * MapScale }; }
+			Vector2 GetPartitionVector() const { return Vector2{ PartitionSlopeX * MapScale, PartitionSlopeY * MapScale }; }
+			Rectangle GetRightBounds() const { return GetBounds(RightBBox); }
+			Rectangle GetLeftBounds() const { return GetBounds(LeftBBox); }
+
+		protected:
+			static Rectangle GetBounds(const int16_t box[4])
+			{
+				return Rectangle{ box[2] * MapScale, box[1] * MapScale, (box[3] - box[2]) * MapScale, (box[0] - box[1]) * MapScale };
+			}
 		};
 
-		std::vector<Node> Contents;
+		bool ReadsInPlace() const override { return true; }
+
+		RecordView<Node> Contents;
 	};
 
 	class GLVertsLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
         int FormatVersion = 0;
 
@@ -250,7 +357,10 @@ namespace WADData
 	class GLSegsLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        // minisegs run along a partition line rather than a linedef, they only close off their subsector
+        static constexpr size_t MiniSegLine = size_t(-1);
 
         struct GLSeg
         {
@@ -262,6 +372,8 @@ namespace WADData
 			size_t LineIndex = 0;
 			size_t Direction = 0;
 			size_t PartnerSegIndex = 0;
+
+			bool IsMiniSeg() const { return LineIndex == MiniSegLine; }
         };
 
 		int FormatVersion = 0;
@@ -272,7 +384,7 @@ namespace WADData
 	class GLSubSectorsLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct GLSubSector
 		{
@@ -285,11 +397,249 @@ namespace WADData
 		std::vector<GLSubSector> Contents;
 	};
 
+    // Which sectors can see each other, from REJECT.
+    // The lump has a bit per sector pair that is set when the pair can't see, this keeps the opposite, stored transposed:
+    // row B has bit A set when sector A can see sector B, so one row answers "which sectors can see B" as whole 64 bit words.
+    class RejectLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        // for levels with no REJECT or one with nothing rejected, only sectors that no two sided line joins are kept apart
+        void BuildFromConnectivity(const LineDefLump& lines, const SideDefLump& sides, size_t sectorCount);
+
+        size_t GetSectorCount() const { return SectorCount; }
+
+        // 64 bit words in each row, rows are padded so every row starts on a word
+        size_t GetRowWords() const { return RowWords; }
+
+        // false when the lump rejected nothing, which is how most tools leave it
+        bool HasRejects() const { return AnyRejects; }
+
+        // sectors outside the matrix can always see
+        bool CanSectorsSee(size_t from, size_t to) const
+        {
+            if (from >= SectorCount || to >= SectorCount)
+                return true;
+
+            return (Visible[to * RowWords + (from >> 6)] >> (from & 63)) & 1;
+        }
+
+        // bit A of the row is set when sector A can see the sector, nullptr outside the matrix
+        const uint64_t* GetSectorsThatSee(size_t sector) const
+        {
+            return sector < SectorCount ? Visible.data() + sector * RowWords : nullptr;
+        }
+
+        // the indexes of the sectors that can see a sector, appended to output
+        void GetSectorsThatSee(size_t sector, std::vector<size_t>& output) const;
+
+        // clears the bits of mask (GetRowWords long) for sectors that can't see the sector, to filter many sectors at once
+        void FilterSectorsThatSee(size_t sector, uint64_t* mask) const;
+
+    protected:
+        void Resize(size_t sectorCount);
+
+        size_t SectorCount = 0;
+        size_t RowWords = 0;
+        bool AnyRejects = false;
+
+        std::vector<uint64_t> Visible;
+    };
+
+    // Which GL subsectors can be seen from each other, from the GL_PVS lump glVIS writes.
+    // The lump has a row of bits per subsector, padded to a byte, with a bit set for each subsector visible from it.
+    // This keeps the same rows padded to 64 bit words, so a row can be walked or masked a word at a time.
+    class GLPVSLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        // false when the lump was empty or too short for the subsectors, nothing should be culled with it then
+        bool IsValid() const { return SubSectorCount > 0; }
+
+        size_t GetSubSectorCount() const { return SubSectorCount; }
+
+        // 64 bit words in each row
+        size_t GetRowWords() const { return RowWords; }
+
+        // subsectors outside the matrix are always visible
+        bool IsSubSectorVisible(size_t from, size_t to) const
+        {
+            if (from >= SubSectorCount || to >= SubSectorCount)
+                return true;
+
+            return (Visible[from * RowWords + (to >> 6)] >> (to & 63)) & 1;
+        }
+
+        // bit N of the row is set when subsector N is visible from the subsector, nullptr outside the matrix
+        const uint64_t* GetVisibleSubSectors(size_t from) const
+        {
+            return from < SubSectorCount ? Visible.data() + from * RowWords : nullptr;
+        }
+
+        // the indexes of the subsectors visible from a subsector, appended to output
+        void GetVisibleSubSectors(size_t from, std::vector<size_t>& output) const;
+
+    protected:
+        size_t SubSectorCount = 0;
+        size_t RowWords = 0;
+
+        std::vector<uint64_t> Visible;
+    };
+
+    // The BLOCKMAP grid of 128 unit blocks, each listing the linedefs that touch it.
+    // The lump's per block lists are flattened into one array of line indexes with an offset per block (compressed sparse rows).
+    class BlockMapLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        // makes the grid from the linedefs, for maps with no BLOCKMAP or one that overflowed
+        void Build(const VertexesLump& verts, const LineDefLump& lines);
+
+        // in map units
+        static constexpr int32_t BlockSize = 128;
+
+        // offsets are 16 bit word counts, past this many words they wrap around and can't be trusted
+        static constexpr size_t MaxWords = 0x10000;
+
+        // the bottom left corner of the grid, in map units
+        int32_t OriginX = 0;
+        int32_t OriginY = 0;
+
+        int32_t Columns = 0;
+        int32_t Rows = 0;
+
+        // the lines of block (column, row) are Lines[Offsets[i]] up to Lines[Offsets[i + 1]], where i = row * Columns + column
+        std::vector<uint32_t> Offsets;
+        std::vector<uint32_t> Lines;
+
+        bool IsValid() const { return !Offsets.empty(); }
+
+        // one past the highest line index in any block, to check the grid against LINEDEFS
+        uint32_t GetLineLimit() const { return LineLimit; }
+
+        // the lines in a block, nullptr (and a count of 0) outside the grid
+        const uint32_t* GetBlockLines(int32_t column, int32_t row, size_t& count) const;
+
+        int32_t GetColumn(double x) const;
+        int32_t GetRow(double y) const;
+
+        // these take map units and call visit once per line, even when it is in more than one block
+        // visit returns false to stop early, which makes these return false too
+        bool ForEachLineInBox(double minX, double minY, double maxX, double maxY, const std::function<bool(size_t lineIndex)>& visit) const;
+
+        // blocks are visited in the order the segment crosses them, so nearer lines tend to come first
+        bool ForEachLineAlongSegment(double startX, double startY, double endX, double endY, const std::function<bool(size_t lineIndex)>& visit) const;
+
+    protected:
+        uint32_t LineLimit = 0;
+    };
+
+    // ZDoom's extended nodes, every index is 32 bits wide
+    // XNOD replaces NODES, XGLN, XGL2 and XGL3 replace SSECTORS or sit in ZNODES and are full GL nodes
+    enum class ExtendedNodeFormat
+    {
+        None,
+        XNOD,
+        XGLN,
+        XGL2,
+        XGL3,
+    };
+
+    // the format a lump's signature names, the Z signatures (ZNOD, ZGLN, ZGL2, ZGL3) are the same formats zlib compressed
+    ExtendedNodeFormat GetExtendedNodeFormat(const uint8_t* data, size_t size, bool* compressed = nullptr);
+
+    class ExtendedNodesLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        struct Node
+        {
+            // in world units, XGL3 partitions can be fractional
+            Vector2 PartitionStart = { 0 };
+            Vector2 PartitionVector = { 0 };
+
+            // top, bottom, left, right
+            int16_t RightBBox[4] = { 0 };
+            int16_t LeftBBox[4] = { 0 };
+
+            uint32_t RightChild = 0;
+            uint32_t LeftChild = 0;
+        };
+
+        static constexpr uint32_t SubSectorChild = 0x80000000;
+
+        ExtendedNodeFormat Format = ExtendedNodeFormat::None;
+        bool Compressed = false;
+
+        // the XGL formats close every subsector with minisegs, XNOD segs only cover linedefs
+        bool IsGL() const { return Format == ExtendedNodeFormat::XGLN || Format == ExtendedNodeFormat::XGL2 || Format == ExtendedNodeFormat::XGL3; }
+
+        // seg vertex indexes below this are VERTEXES, the rest are the vertices the node builder added
+        uint32_t OriginalVertexCount = 0;
+
+        // the nodes in the shape the GL lumps are read in, added vertices are flagged as GL vertices
+        GLVertsLump GLVerts;
+        GLSegsLump GLSegs;
+        GLSubSectorsLump GLSubSectors;
+
+        std::vector<Node> Nodes;
+
+        // writes GL nodes back out as an uncompressed XGL3 lump, that Parse reads back to the same nodes
+        bool WriteXGL3(std::vector<uint8_t>& output) const;
+
+    protected:
+        bool ReadNodes(const uint8_t* data, size_t size);
+    };
+
+    // GL_NODES, read into the same nodes as extended nodes so both can be walked the same way
+    // V5 has 32 bit children, the older versions have the 16 bit children vanilla NODES has
+    class GLNodesLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        std::vector<ExtendedNodesLump::Node> Contents;
+    };
+
+
+    // A UDMF map, read from the TEXTMAP text lump.
+    // The blocks are read into the same lumps a binary map has, so the rest of the level can't tell the two apart.
+    // Positions and heights keep their fractions in the world unit values, the map unit fields are rounded.
+    // Linedefs and sidedefs index with 16 bits, a map with more vertices, sidedefs or sectors than that isn't read.
+    class UDMFLump : public Lump
+    {
+    public:
+        void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
+
+        // false when the text couldn't be read, or it describes a map the binary lumps can't hold
+        bool IsValid() const { return Valid; }
+
+        // the namespace the map was written for, such as "doom" or "zdoom"
+        std::string Namespace;
+
+        ThingsLump Things;
+        VertexesLump Verts;
+        LineDefLump Lines;
+        SideDefLump Sides;
+        SectorsLump Sectors;
+
+    protected:
+        bool Valid = false;
+
+        // the records the vertex and linedef lumps view, in the binary layout
+        std::vector<uint8_t> VertexRecords;
+        std::vector<uint8_t> LineRecords;
+    };
+
 
     class PlayPalLump : public Lump
     {
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
 		struct Palette
 		{
@@ -304,15 +654,15 @@ namespace WADData
 	class PatchNamesLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
-		std::vector<std::string> Contents;
+		std::vector<WadName> Contents;
 	};
 
     class TexturesLump : public Lump
 	{
 	public:
-		void Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion = 0) override;
+		void Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context) override;
 
         struct PatchInfo
         {
@@ -328,7 +678,7 @@ namespace WADData
 
 		struct TextureDef
 		{
-            std::string Name;
+            WadName Name;
             uint32_t Masked = 9;
             uint16_t Width = 0;
             uint16_t Height = 0;
@@ -340,7 +690,66 @@ namespace WADData
 			static constexpr size_t ReadSize = 16;
 		};
 
-		std::unordered_map<std::string, TextureDef> Contents;
+		WadNameMap<TextureDef> Contents;
 	};
 
+    template<class T>
+    Lump* CreateLump() { return new T(); }
+
+    // Maps lump names to the type that parses them
+    struct LumpType
+    {
+        WadName Name;
+        Lump* (*Create)() = nullptr;
+    };
+
+    static constexpr LumpType LumpTypes[] =
+    {
+        // map lumps
+        { THINGS, &CreateLump<ThingsLump> },
+        { VERTEXES, &CreateLump<VertexesLump> },
+        { LINEDEFS, &CreateLump<LineDefLump> },
+        { SIDEDEFS, &CreateLump<SideDefLump> },
+        { SECTORS, &CreateLump<SectorsLump> },
+        { SEGS, &CreateLump<SegsLump> },
+        { SSECTORS, &CreateLump<SubSectorsLump> },
+        { NODES, &CreateLump<NodesLump> },
+        { REJECT, &CreateLump<RejectLump> },
+        { BLOCKMAP, &CreateLump<BlockMapLump> },
+
+        // map gl lumps
+        { GL_VERT, &CreateLump<GLVertsLump> },
+        { GL_SEGS, &CreateLump<GLSegsLump> },
+        { GL_SSECT, &CreateLump<GLSubSectorsLump> },
+        { GL_NODES, &CreateLump<GLNodesLump> },
+        { GL_PVS, &CreateLump<GLPVSLump> },
+        { ZNODES, &CreateLump<ExtendedNodesLump> },
+        { TEXTMAP, &CreateLump<UDMFLump> },
+
+        // texture lumps
+        { PLAYPAL, &CreateLump<PlayPalLump> },
+        { PNAMES, &CreateLump<PatchNamesLump> },
+        { TEXTURE, &CreateLump<TexturesLump> },
+        { TEXTURE1, &CreateLump<TexturesLump> },
+        { TEXTURE2, &CreateLump<TexturesLump> },
+    };
+
+    constexpr const LumpType* FindLumpType(WadName name)
+    {
+        for (const auto& type : LumpTypes)
+        {
+            if (type.Name == name)
+                return &type;
+        }
+
+        return nullptr;
+    }
+
+    // true when lumps with this name are parsed by T
+    template<class T>
+    constexpr bool IsLumpType(WadName name)
+    {
+        const LumpType* type = FindLumpType(name);
+        return type && type->Create == &CreateLump<T>;
+    }
 }
\ No newline at end of file
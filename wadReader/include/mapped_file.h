@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace WADReader
+{
+    // A read only view of an entire file, backed by the OS page cache.
+    // Pages are faulted in on first access, so untouched lumps never become resident.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const char* fileName);
+        void Close();
+
+        bool IsOpen() const { return Data != nullptr; }
+
+        uint8_t* GetData() const { return Data; }
+        size_t GetSize() const { return Size; }
+
+    protected:
+        uint8_t* Data = nullptr;
+        size_t Size = 0;
+
+#if defined(_WIN32)
+        void* FileHandle = nullptr;
+        void* MappingHandle = nullptr;
+#endif
+    };
+}
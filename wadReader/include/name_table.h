@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#include "wad_name.h"
+
+namespace WADData
+{
+    // Gives each distinct name a small dense ID, so things that reference textures or flats can store 2 bytes and caches can be plain arrays.
+    // IDs are handed out in the order names are first seen and never change while the table lives.
+    // Interning is locked, since levels loading on different threads share one table.
+    class NameTable
+    {
+    public:
+        // the ID of the empty name and of "-", which both mean there is nothing to draw
+        static constexpr uint16_t None = 0;
+
+        NameTable() { Clear(); }
+
+        // the ID for a name, adding it if it's new, None when the table is full
+        uint16_t Intern(WadName name);
+
+        // the ID for a name, or None if it was never interned
+        uint16_t Find(WadName name) const;
+
+        WadName GetName(uint16_t id) const;
+
+        // the number of IDs handed out, None included
+        size_t size() const;
+
+        void Clear();
+
+    protected:
+        mutable std::mutex Lock;
+        std::vector<WadName> Names;
+        WadNameMap<uint16_t> Ids;
+    };
+
+    // interns names through a local map first, so the shared table is only locked once per distinct name in a lump
+    class NameInterner
+    {
+    public:
+        NameInterner(NameTable* table) : Table(table) {}
+
+        uint16_t Intern(WadName name)
+        {
+            if (!Table)
+                return NameTable::None;
+
+            uint16_t* id = Seen.Find(name);
+            if (id)
+                return *id;
+
+            return Seen.Insert(name, Table->Intern(name));
+        }
+
+    protected:
+        NameTable* Table = nullptr;
+        WadNameMap<uint16_t> Seen;
+    };
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "lump_types.h"
+
+namespace WADData
+{
+    // Builds GL nodes for a level that shipped without any, from its linedefs, sidedefs and vertices.
+    // Partitions are picked from the linedefs by scoring splits and balance, big seg sets score their candidates on workerCount threads (0 uses one per core).
+    // Each leaf is closed by carving the region the tree gives it with its own segs, the gaps are filled with minisegs.
+    // The result has the shape of XGL3 nodes, so the level uses and caches it the same way as nodes read from ZNODES.
+    bool BuildGLNodes(const VertexesLump& verts, const LineDefLump& lines, const SideDefLump& sides, ExtendedNodesLump& nodes, size_t workerCount = 0);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+namespace WADReader
+{
+    // the number of threads ParallelFor uses when it is not given a count, one per core
+    size_t GetDefaultWorkerCount();
+
+    // Calls work for every index below count on a pool of threads and returns once they have all finished.
+    // Indexes are handed out one at a time, so items that take different amounts of time still balance across the threads.
+    // The calling thread does work too, with one worker (or one item) everything runs on the calling thread.
+    void ParallelFor(size_t count, const std::function<void(size_t index)>& work, size_t workerCount = 0);
+}
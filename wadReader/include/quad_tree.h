@@ -0,0 +1,258 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "span.h"
+
+namespace WADData
+{
+    // A loose quadtree over boxes for range and nearest queries, built once with every item and queried without allocating.
+    // An item lives in the deepest cell that holds its centre and is at least twice its size, so no item is split between cells,
+    // and each node keeps the box around everything under it so a query only descends where there is something to find.
+    class QuadTree
+    {
+    public:
+        struct Bounds
+        {
+            float MinX = INFINITY;
+            float MinY = INFINITY;
+            float MaxX = -INFINITY;
+            float MaxY = -INFINITY;
+
+            // a box with nothing in it, items with one are left out of the tree
+            bool IsEmpty() const { return !(MinX <= MaxX && MinY <= MaxY); }
+
+            bool Overlaps(const Bounds& other) const { return MinX <= other.MaxX && other.MinX <= MaxX && MinY <= other.MaxY && other.MinY <= MaxY; }
+            bool Contains(const Bounds& other) const { return MinX <= other.MinX && MinY <= other.MinY && other.MaxX <= MaxX && other.MaxY <= MaxY; }
+
+            void Add(const Bounds& other)
+            {
+                MinX = std::min(MinX, other.MinX);
+                MinY = std::min(MinY, other.MinY);
+                MaxX = std::max(MaxX, other.MaxX);
+                MaxY = std::max(MaxY, other.MaxY);
+            }
+
+            // the squared distance from a point to the nearest part of the box, 0 inside it
+            float DistanceSquared(float x, float y) const
+            {
+                float dx = std::max(std::max(MinX - x, x - MaxX), 0.0f);
+                float dy = std::max(std::max(MinY - y, y - MaxY), 0.0f);
+                return dx * dx + dy * dy;
+            }
+        };
+
+        struct Neighbour
+        {
+            uint32_t Index = uint32_t(-1);
+            float DistanceSquared = INFINITY;
+        };
+
+        // deep enough for a cell a few map units across on the biggest maps, and it bounds the size of the query stacks
+        static constexpr int MaxDepth = 16;
+
+        // nodes with this many items or fewer are not split
+        static constexpr size_t LeafSize = 8;
+
+        // items are known by their place in bounds
+        void Build(Span<const Bounds> bounds);
+
+        void Clear();
+
+        // gives an item a new box, the nodes above it only ever grow so the tree stays right but gets looser the further items move
+        void Update(uint32_t index, const Bounds& bounds);
+
+        bool IsBuilt() const { return !Nodes.empty(); }
+
+        // the box around every item, empty when there are none
+        Bounds GetBounds() const { return Nodes.empty() ? Bounds() : Nodes.front().Box; }
+
+        size_t GetItemCount() const { return Items.size(); }
+        size_t GetNodeCount() const { return Nodes.size(); }
+        size_t GetMemoryUse() const { return Nodes.capacity() * sizeof(Node) + Items.capacity() * sizeof(Item) + (Slots.capacity() + ItemNodes.capacity()) * sizeof(uint32_t); }
+
+        // calls visit with the index of each item whose box overlaps the box, visit returns false to stop early
+        template<class Visit>
+        bool ForEachInBox(const Bounds& box, Visit&& visit) const
+        {
+            return Search([&](const Bounds& bounds) { return box.Overlaps(bounds); }, [&](const Bounds& bounds) { return box.Contains(bounds); }, visit);
+        }
+
+        // the same for item boxes that come within radius of a point, the caller tests the items' real shapes if it needs to
+        template<class Visit>
+        bool ForEachInCircle(float x, float y, float radius, Visit&& visit) const
+        {
+            float radiusSquared = radius * radius;
+            return Search([&](const Bounds& bounds) { return bounds.DistanceSquared(x, y) <= radiusSquared; },
+                [&](const Bounds& bounds) { return FarthestSquared(bounds, x, y) <= radiusSquared; }, visit);
+        }
+
+        // writes the indexes of the items ForEachInBox would visit to out, returns how many there are, which can be more than out holds
+        size_t FindInBox(const Bounds& box, Span<uint32_t> out) const;
+        size_t FindInCircle(float x, float y, float radius, Span<uint32_t> out) const;
+
+        // the items nearest a point, up to out.size() of them within maxDistance, closest first, returns how many were found
+        // distance(index) gives the squared distance to an item's real shape, it must not be less than the distance to the item's box
+        template<class Distance>
+        size_t FindNearest(float x, float y, float maxDistance, Span<Neighbour> out, Distance&& distance) const
+        {
+            if (out.empty() || Nodes.empty())
+                return 0;
+
+            size_t found = 0;
+            float limit = maxDistance * maxDistance;
+
+            // what an item has to beat to get in, the farthest one found once out is full
+            auto bound = [&]() { return found < out.size() ? limit : out[found - 1].DistanceSquared; };
+
+            uint32_t stack[StackSize];
+            size_t depth = 0;
+            stack[depth++] = 0;
+
+            while (depth > 0)
+            {
+                const Node& node = Nodes[stack[--depth]];
+                if (node.Box.DistanceSquared(x, y) > bound())
+                    continue;
+
+                for (uint32_t slot = node.FirstItem; slot < node.FirstItem + node.ItemCount; slot++)
+                {
+                    const Item& item = Items[slot];
+                    if (item.Box.DistanceSquared(x, y) > bound())
+                        continue;
+
+                    float itemDistance = distance(item.Index);
+                    if (!(itemDistance <= bound()))
+                        continue;
+
+                    // an insertion sort, out is expected to be short
+                    size_t place = found < out.size() ? found++ : found - 1;
+                    while (place > 0 && out[place - 1].DistanceSquared > itemDistance)
+                    {
+                        out[place] = out[place - 1];
+                        place--;
+                    }
+                    out[place] = Neighbour{ item.Index, itemDistance };
+                }
+
+                // the nearest child goes on the stack last so it is searched first and tightens the bound for the others
+                uint32_t children[4];
+                float childDistances[4];
+                for (uint32_t i = 0; i < node.ChildCount; i++)
+                {
+                    uint32_t child = node.FirstChild + i;
+                    float childDistance = Nodes[child].Box.DistanceSquared(x, y);
+
+                    uint32_t place = i;
+                    while (place > 0 && childDistances[place - 1] < childDistance)
+                    {
+                        children[place] = children[place - 1];
+                        childDistances[place] = childDistances[place - 1];
+                        place--;
+                    }
+                    children[place] = child;
+                    childDistances[place] = childDistance;
+                }
+
+                for (uint32_t i = 0; i < node.ChildCount; i++)
+                {
+                    if (childDistances[i] <= bound())
+                        stack[depth++] = children[i];
+                }
+            }
+
+            return found;
+        }
+
+        // nearest by the distance to the items' boxes
+        size_t FindNearest(float x, float y, float maxDistance, Span<Neighbour> out) const;
+
+    protected:
+        struct Node
+        {
+            // everything in this node and under it
+            Bounds Box;
+
+            // this node's own items are Items[FirstItem] up to FirstItem + ItemCount, and everything under it runs on to SubtreeEnd
+            uint32_t FirstItem = 0;
+            uint32_t ItemCount = 0;
+            uint32_t SubtreeEnd = 0;
+
+            // the children are next to each other
+            uint32_t FirstChild = 0;
+            uint32_t ChildCount = 0;
+
+            uint32_t Parent = uint32_t(-1);
+        };
+
+        struct Item
+        {
+            Bounds Box;
+            uint32_t Index = 0;
+        };
+
+        // each level of a depth first walk leaves at most 3 siblings on the stack
+        static constexpr size_t StackSize = 3 * MaxDepth + 4;
+
+        // the squared distance from a point to the farthest corner of a box
+        static float FarthestSquared(const Bounds& bounds, float x, float y)
+        {
+            float dx = std::max(x - bounds.MinX, bounds.MaxX - x);
+            float dy = std::max(y - bounds.MinY, bounds.MaxY - y);
+            return dx * dx + dy * dy;
+        }
+
+        // the walk behind the range queries, overlaps says if a box may hold matches and inside says if everything in it matches
+        template<class Overlaps, class Inside, class Visit>
+        bool Search(Overlaps&& overlaps, Inside&& inside, Visit&& visit) const
+        {
+            if (Nodes.empty())
+                return true;
+
+            uint32_t stack[StackSize];
+            size_t depth = 0;
+            stack[depth++] = 0;
+
+            while (depth > 0)
+            {
+                const Node& node = Nodes[stack[--depth]];
+                if (!overlaps(node.Box))
+                    continue;
+
+                // a node wholly in the query hands over everything under it without testing, its items follow each other
+                if (inside(node.Box))
+                {
+                    for (uint32_t slot = node.FirstItem; slot < node.SubtreeEnd; slot++)
+                    {
+                        if (!visit(Items[slot].Index))
+                            return false;
+                    }
+                    continue;
+                }
+
+                for (uint32_t slot = node.FirstItem; slot < node.FirstItem + node.ItemCount; slot++)
+                {
+                    if (overlaps(Items[slot].Box) && !visit(Items[slot].Index))
+                        return false;
+                }
+
+                for (uint32_t i = 0; i < node.ChildCount; i++)
+                    stack[depth++] = node.FirstChild + i;
+            }
+
+            return true;
+        }
+
+        void BuildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, float cellX, float cellY, float cellSize, int depth);
+
+        std::vector<Node> Nodes;
+        std::vector<Item> Items;
+
+        // for each index, where its item is in Items, uint32_t(-1) for items left out, and for each item the node holding it
+        std::vector<uint32_t> Slots;
+        std::vector<uint32_t> ItemNodes;
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace WADReader
+{
+    // A file that is read with positioned reads (pread) and never loaded as a whole.
+    // Read does not move a shared file cursor, so it can be called from several threads at once.
+    class RandomAccessFile
+    {
+    public:
+        RandomAccessFile() = default;
+        ~RandomAccessFile();
+
+        RandomAccessFile(const RandomAccessFile&) = delete;
+        RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+        bool Open(const char* fileName);
+        void Close();
+
+        bool IsOpen() const;
+
+        size_t GetSize() const { return Size; }
+
+        bool Read(size_t offset, size_t size, uint8_t* destination) const;
+
+    protected:
+        size_t Size = 0;
+
+#if defined(_WIN32)
+        void* FileHandle = nullptr;
+#else
+        int FileDescriptor = -1;
+#endif
+    };
+}
@@ -7,13 +7,27 @@
 
 namespace WADReader
 {
+    class LumpSource;
+
     int32_t ReadInt(uint8_t* buffer, size_t& offset);
     uint32_t ReadUInt(uint8_t* buffer, size_t& offset);
     int16_t ReadInt16(uint8_t* buffer, size_t& offset);
     uint16_t ReadUInt16(uint8_t* buffer, size_t& offset);
     uint8_t ReadUInt8(uint8_t* buffer, size_t& offset);
-    std::string ReadName(uint8_t* buffer, size_t& offset);
+    WADData::WadName ReadName(uint8_t* buffer, size_t& offset);
+
+    // Bulk decoders for arrays of little endian values.
+    // The source can have any alignment, SIMD is used when the build targets AVX2, SSE2 or NEON and plain loops are used otherwise.
+
+    // count pairs of int16 (x, y), converted to float and multiplied by scale
+    void DecodeInt16Pairs(const uint8_t* source, size_t count, Vector2* destination, float scale);
+
+    // count pairs of 16.16 fixed point int32 (x, y), converted to float and multiplied by scale
+    void DecodeFixedPairs(const uint8_t* source, size_t count, Vector2* destination, float scale);
 
     WADData::DirectoryEntry ReadDirectoryEntry(uint8_t* buffer, size_t& readOffset);
     std::vector<WADData::DirectoryEntry> ReadDirectoryEntries(uint8_t* buffer);
+
+    // reads the directory of an archive that may not be resident, every entry references the source
+    std::vector<WADData::DirectoryEntry> ReadDirectoryEntries(LumpSource& source);
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace WADData
+{
+    // little endian loads that work on any alignment and any host byte order
+    inline uint16_t LoadUInt16LE(const uint8_t* bytes) { return uint16_t(bytes[0] | (bytes[1] << 8)); }
+    inline int16_t LoadInt16LE(const uint8_t* bytes) { return int16_t(LoadUInt16LE(bytes)); }
+    inline uint32_t LoadUInt32LE(const uint8_t* bytes) { return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24); }
+    inline int32_t LoadInt32LE(const uint8_t* bytes) { return int32_t(LoadUInt32LE(bytes)); }
+
+    // A read only view of an array of fixed size on-disk records.
+    // Nothing is copied up front, each record is decoded from the lump bytes when it is indexed, so records are returned by value.
+    // Record needs a ReadSize and a static Read(const uint8_t*) that decodes one record.
+    template<class Record>
+    class RecordView
+    {
+    public:
+        class Iterator
+        {
+        public:
+            Iterator(const uint8_t* position) : Position(position) {}
+
+            Record operator*() const { return Record::Read(Position); }
+
+            Iterator& operator++()
+            {
+                Position += Record::ReadSize;
+                return *this;
+            }
+
+            bool operator==(const Iterator& other) const { return Position == other.Position; }
+            bool operator!=(const Iterator& other) const { return Position != other.Position; }
+
+        protected:
+            const uint8_t* Position = nullptr;
+        };
+
+        RecordView() = default;
+        RecordView(const uint8_t* data, size_t size) : Data(data), Count(size / Record::ReadSize) {}
+
+        size_t size() const { return Count; }
+        bool empty() const { return Count == 0; }
+
+        Record operator[](size_t index) const { return Record::Read(Data + index * Record::ReadSize); }
+
+        Iterator begin() const { return Iterator(Data); }
+        Iterator end() const { return Iterator(Data + Count * Record::ReadSize); }
+
+        // the raw records
+        const uint8_t* data() const { return Data; }
+
+    protected:
+        const uint8_t* Data = nullptr;
+        size_t Count = 0;
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "doom_map.h"
+
+// An IWAD with any number of PWADs mounted over it.
+// Every lookup goes through one merged index, lumps and levels in later archives replace the ones with the same name in earlier archives.
+class ResourceStack : public WADFile
+{
+public:
+    // mounts an archive over everything already mounted, returns false if it could not be opened
+    bool Mount(const char* fileName);
+
+    // mounts several archives in order and builds the merged index once, returns how many could be opened
+    size_t Mount(const std::vector<std::string>& fileNames);
+
+    void UnmountAll() { CloseFile(); }
+
+    size_t GetMountCount() const { return Sources.size(); }
+    const std::string& GetMountName(size_t index) const { return SourceNames[index]; }
+    WADReader::LumpSource* GetMountSource(size_t index) const { return Sources[index].get(); }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "lump_types.h"
+#include "span.h"
+#include "vertex_table.h"
+
+namespace WADData
+{
+    // A fixed resolution image of which sector covers each cell of a level, so most point lookups are one array read.
+    // Cells a subsector edge crosses don't belong to one sector, they are marked Mixed and need an exact lookup.
+    class SectorGrid
+    {
+    public:
+        static constexpr uint16_t Outside = 0xFFFF;
+        static constexpr uint16_t Mixed = 0xFFFE;
+
+        // bigger grids than this are not built, 64 MB of cells
+        static constexpr size_t MaxCells = size_t(32) << 20;
+
+        // rasterizes the GL subsectors, cellSize is in world units and subSectorSectors holds each subsector's sector, uint32_t(-1) for none
+        // fails when the grid would be too big or a sector index doesn't fit in 16 bits
+        bool Build(const VertexTable& vertices, Span<const uint32_t> segStarts, Span<const uint32_t> segEnds, const GLSubSectorsLump& subSectors, Span<const uint32_t> subSectorSectors, float cellSize);
+
+        void Clear();
+
+        bool IsBuilt() const { return !Cells.empty(); }
+
+        // the sector at a point in world units, Outside off the grid or the map and Mixed where an exact lookup is needed
+        uint16_t Get(float x, float y) const
+        {
+            float column = (x - OriginX) * InverseCellSize;
+            float row = (y - OriginY) * InverseCellSize;
+
+            // written so a point that isn't a number lands outside too
+            if (!(column >= 0 && row >= 0 && column < float(Columns) && row < float(Rows)))
+                return Outside;
+
+            return Cells[size_t(row) * Columns + size_t(column)];
+        }
+
+        int32_t GetColumns() const { return Columns; }
+        int32_t GetRows() const { return Rows; }
+        float GetCellSize() const { return CellSize; }
+
+        size_t GetMixedCount() const { return MixedCount; }
+        size_t GetMemoryUse() const { return Cells.capacity() * sizeof(uint16_t); }
+
+    protected:
+        // the bottom left corner of the grid, in world units
+        float OriginX = 0;
+        float OriginY = 0;
+        float CellSize = 0;
+        float InverseCellSize = 0;
+
+        int32_t Columns = 0;
+        int32_t Rows = 0;
+
+        std::vector<uint16_t> Cells;
+        size_t MixedCount = 0;
+    };
+}
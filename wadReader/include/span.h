@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <type_traits>
+
+namespace WADData
+{
+    // A non owning view of a contiguous run of items
+    template<class T>
+    class Span
+    {
+    public:
+        constexpr Span() = default;
+        constexpr Span(T* data, size_t count) : Data(data), Count(count) {}
+
+        template<class U, class = typename std::enable_if<std::is_convertible<U(*)[], T(*)[]>::value>::type>
+        Span(std::vector<U>& items) : Data(items.data()), Count(items.size()) {}
+
+        template<class U, class = typename std::enable_if<std::is_convertible<const U(*)[], T(*)[]>::value>::type>
+        Span(const std::vector<U>& items) : Data(items.data()), Count(items.size()) {}
+
+        constexpr T* data() const { return Data; }
+        constexpr size_t size() const { return Count; }
+        constexpr bool empty() const { return Count == 0; }
+
+        constexpr T* begin() const { return Data; }
+        constexpr T* end() const { return Data + Count; }
+
+        constexpr T& operator[](size_t index) const { return Data[index]; }
+
+        constexpr Span<T> Slice(size_t start, size_t count) const { return Span<T>(Data + start, count); }
+
+    protected:
+        T* Data = nullptr;
+        size_t Count = 0;
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "lump_types.h"
+
+namespace WADData
+{
+    // Every vertex of a level in one index space, the VERTEXES first then the GL_VERT vertices.
+    // Coordinates are kept as separate arrays of X and Y in world units, so passes over many vertices can run several at a time.
+    class VertexTable
+    {
+    public:
+        void Build(const VertexesLump* verts, const GLVertsLump* glVerts);
+        void Clear();
+
+        size_t size() const { return Xs.size(); }
+        bool empty() const { return Xs.empty(); }
+
+        // the index of the first GL vertex
+        size_t GetGLBase() const { return GLBase; }
+
+        // converts a vertex reference from a GL seg into the shared index space
+        uint32_t GetIndex(size_t index, bool isGLVert) const { return uint32_t(index + (isGLVert ? GLBase : 0)); }
+
+        Vector2 Get(size_t index) const { return Vector2{ Xs[index], Ys[index] }; }
+
+        const float* GetXs() const { return Xs.data(); }
+        const float* GetYs() const { return Ys.data(); }
+
+        // the box around every vertex
+        Rectangle GetBounds() const;
+
+    protected:
+        std::vector<float> Xs;
+        std::vector<float> Ys;
+        size_t GLBase = 0;
+    };
+}
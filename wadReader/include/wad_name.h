@@ -0,0 +1,251 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace WADData
+{
+    // A lump name packed into a single integer.
+    // Names are at most 8 characters, so the bytes are stored little endian in a uint64_t and compared in one instruction.
+    // Names are upper cased when they are packed, like the original engine does when it looks up a lump.
+    class WadName
+    {
+    public:
+        constexpr WadName() = default;
+        constexpr WadName(const char* name) : Value(Pack(name, 8)) {}
+        WadName(const std::string& name) : Value(Pack(name.c_str(), name.size() < 8 ? name.size() : 8)) {}
+
+        // reads the fixed 8 byte name field used by the directory and map lumps
+        static WadName FromBytes(const uint8_t* bytes)
+        {
+            WadName name;
+            name.Value = Pack((const char*)bytes, 8);
+            return name;
+        }
+
+        static constexpr WadName FromValue(uint64_t value)
+        {
+            WadName name;
+            name.Value = value;
+            return name;
+        }
+
+        constexpr uint64_t GetValue() const { return Value; }
+
+        constexpr bool IsEmpty() const { return Value == 0; }
+
+        constexpr size_t Length() const
+        {
+            size_t length = 0;
+            while (length < 8 && ((Value >> (length * 8)) & 0xFF) != 0)
+                length++;
+            return length;
+        }
+
+        constexpr bool StartsWith(WadName prefix) const
+        {
+            size_t length = prefix.Length();
+            if (length == 0)
+                return true;
+
+            uint64_t mask = length >= 8 ? ~uint64_t(0) : (uint64_t(1) << (length * 8)) - 1;
+            return (Value & mask) == prefix.Value;
+        }
+
+        constexpr bool EndsWith(WadName suffix) const
+        {
+            size_t length = Length();
+            size_t suffixLength = suffix.Length();
+            if (suffixLength > length)
+                return false;
+
+            return (Value >> ((length - suffixLength) * 8)) == suffix.Value;
+        }
+
+        constexpr char operator[](size_t index) const { return index < 8 ? char((Value >> (index * 8)) & 0xFF) : 0; }
+
+        std::string ToString() const
+        {
+            char text[9] = { 0 };
+            for (size_t i = 0; i < 8; i++)
+                text[i] = (*this)[i];
+            return std::string(text);
+        }
+
+        constexpr bool operator==(const WadName& other) const { return Value == other.Value; }
+        constexpr bool operator!=(const WadName& other) const { return Value != other.Value; }
+        constexpr bool operator<(const WadName& other) const { return Value < other.Value; }
+
+    protected:
+        static constexpr uint64_t Pack(const char* name, size_t maxLength)
+        {
+            uint64_t value = 0;
+            for (size_t i = 0; i < maxLength && name[i] != 0; i++)
+            {
+                char c = name[i];
+                if (c >= 'a' && c <= 'z')
+                    c = char(c - 'a' + 'A');
+
+                value |= uint64_t(uint8_t(c)) << (i * 8);
+            }
+            return value;
+        }
+
+        uint64_t Value = 0;
+    };
+
+    struct WadNameHash
+    {
+        size_t operator()(const WadName& name) const { return size_t((name.GetValue() * 0x9E3779B97F4A7C15ull) >> 32); }
+    };
+
+    // A flat open addressing hash map keyed by lump names.
+    // Keys are probed in a packed array of integers, the items themselves are kept dense in insertion order.
+    // Inserting may move items, so pointers returned by Find are only valid until the next insert.
+    template<class T>
+    class WadNameMap
+    {
+    public:
+        struct Item
+        {
+            WadName Key;
+            T Value;
+        };
+
+        T* Find(WadName name)
+        {
+            size_t slot = FindSlot(name);
+            return slot == InvalidSlot ? nullptr : &Items[Indexes[slot]].Value;
+        }
+
+        const T* Find(WadName name) const
+        {
+            size_t slot = FindSlot(name);
+            return slot == InvalidSlot ? nullptr : &Items[Indexes[slot]].Value;
+        }
+
+        bool Contains(WadName name) const { return FindSlot(name) != InvalidSlot; }
+
+        T& operator[](WadName name)
+        {
+            T* value = Find(name);
+            if (value)
+                return *value;
+
+            return Add(name, T());
+        }
+
+        T& Insert(WadName name, const T& value)
+        {
+            T* existing = Find(name);
+            if (existing)
+            {
+                *existing = value;
+                return *existing;
+            }
+
+            return Add(name, value);
+        }
+
+        size_t size() const { return Items.size(); }
+        bool empty() const { return Items.empty(); }
+
+        void clear()
+        {
+            Keys.clear();
+            Indexes.clear();
+            Items.clear();
+        }
+
+        void reserve(size_t count)
+        {
+            Items.reserve(count);
+            if (count * 2 > Keys.size())
+                Rehash(count * 2);
+        }
+
+        typename std::vector<Item>::iterator begin() { return Items.begin(); }
+        typename std::vector<Item>::iterator end() { return Items.end(); }
+        typename std::vector<Item>::const_iterator begin() const { return Items.begin(); }
+        typename std::vector<Item>::const_iterator end() const { return Items.end(); }
+
+    protected:
+        static constexpr size_t InvalidSlot = size_t(-1);
+
+        // names are 7 bit text, so flipping the top bit means no stored key is ever 0, even the empty name
+        static constexpr uint64_t KeyMarker = uint64_t(1) << 63;
+
+        // fibonacci hashing, the top bits of the product pick the slot
+        size_t SlotOf(WadName name) const { return size_t((name.GetValue() * 0x9E3779B97F4A7C15ull) >> Shift); }
+
+        size_t FindSlot(WadName name) const
+        {
+            if (Keys.empty())
+                return InvalidSlot;
+
+            uint64_t key = name.GetValue() ^ KeyMarker;
+            size_t mask = Keys.size() - 1;
+
+            for (size_t slot = SlotOf(name); ; slot = (slot + 1) & mask)
+            {
+                if (Keys[slot] == key)
+                    return slot;
+                if (Keys[slot] == 0)
+                    return InvalidSlot;
+            }
+        }
+
+        T& Add(WadName name, const T& value)
+        {
+            if ((Items.size() + 1) * 2 > Keys.size())
+                Rehash(Keys.empty() ? 16 : Keys.size() * 2);
+
+            Place(name, uint32_t(Items.size()));
+            Items.push_back(Item{ name, value });
+            return Items.back().Value;
+        }
+
+        void Place(WadName name, uint32_t index)
+        {
+            size_t mask = Keys.size() - 1;
+            size_t slot = SlotOf(name);
+            while (Keys[slot] != 0)
+                slot = (slot + 1) & mask;
+
+            Keys[slot] = name.GetValue() ^ KeyMarker;
+            Indexes[slot] = index;
+        }
+
+        void Rehash(size_t minimumSize)
+        {
+            size_t size = 16;
+            Shift = 60;
+            while (size < minimumSize)
+            {
+                size *= 2;
+                Shift--;
+            }
+
+            Keys.assign(size, 0);
+            Indexes.assign(size, 0);
+
+            for (size_t i = 0; i < Items.size(); i++)
+                Place(Items[i].Key, uint32_t(i));
+        }
+
+        std::vector<uint64_t> Keys;
+        std::vector<uint32_t> Indexes;
+        std::vector<Item> Items;
+        size_t Shift = 60;
+    };
+}
+
+namespace std
+{
+    template<>
+    struct hash<WADData::WadName>
+    {
+        size_t operator()(const WADData::WadName& name) const { return WADData::WadNameHash()(name); }
+    };
+}
@@ -0,0 +1,362 @@
+#include "lump_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace WADData
+{
+    // marks lines already handed to a visitor, a new stamp per query means nothing has to be cleared between queries
+    // each thread has its own, so queries can run on any thread but a visitor can't start another query
+    class VisitedLines
+    {
+    public:
+        void Begin(size_t lineCount)
+        {
+            if (Stamps.size() < lineCount)
+                Stamps.resize(lineCount, 0);
+
+            if (++Current == 0)
+            {
+                std::fill(Stamps.begin(), Stamps.end(), 0);
+                Current = 1;
+            }
+        }
+
+        bool Visit(uint32_t line)
+        {
+            if (Stamps[line] == Current)
+                return false;
+
+            Stamps[line] = Current;
+            return true;
+        }
+
+    protected:
+        std::vector<uint32_t> Stamps;
+        uint32_t Current = 0;
+    };
+
+    static thread_local VisitedLines Visited;
+
+    void BlockMapLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        Offsets.clear();
+        Lines.clear();
+        LineLimit = 0;
+
+        if (size < 8)
+            return;
+
+        const uint8_t* bytes = data + offset;
+        size_t words = size / 2;
+
+        OriginX = LoadInt16LE(bytes);
+        OriginY = LoadInt16LE(bytes + 2);
+        Columns = LoadUInt16LE(bytes + 4);
+        Rows = LoadUInt16LE(bytes + 6);
+
+        size_t blockCount = size_t(Columns) * size_t(Rows);
+        if (blockCount == 0 || words > MaxWords || 4 + blockCount > words)
+            return;
+
+        Offsets.reserve(blockCount + 1);
+        Offsets.push_back(0);
+
+        for (size_t block = 0; block < blockCount; block++)
+        {
+            size_t word = LoadUInt16LE(bytes + 8 + block * 2);
+
+            // every list starts with a 0 that isn't a line, and ends with 0xFFFF
+            if (word < words && LoadUInt16LE(bytes + word * 2) == 0)
+                word++;
+
+            for (;; word++)
+            {
+                if (word >= words)
+                {
+                    Offsets.clear();
+                    Lines.clear();
+                    LineLimit = 0;
+                    return;
+                }
+
+                uint16_t line = LoadUInt16LE(bytes + word * 2);
+                if (line == 0xFFFF)
+                    break;
+
+                Lines.push_back(line);
+                LineLimit = std::max(LineLimit, uint32_t(line) + 1);
+            }
+
+            Offsets.push_back(uint32_t(Lines.size()));
+        }
+    }
+
+    // true when the line touches the block, the bounds have already been checked
+    static bool LineTouchesBlock(double x1, double y1, double x2, double y2, double left, double bottom, double size)
+    {
+        double dx = x2 - x1;
+        double dy = y2 - y1;
+
+        auto side = [&](double x, double y) { return (x - x1) * dy - (y - y1) * dx; };
+
+        double corners[4] = { side(left, bottom), side(left + size, bottom), side(left, bottom + size), side(left + size, bottom + size) };
+
+        bool anyFront = false;
+        bool anyBack = false;
+        for (double corner : corners)
+        {
+            anyFront |= corner >= 0;
+            anyBack |= corner <= 0;
+        }
+
+        return anyFront && anyBack;
+    }
+
+    void BlockMapLump::Build(const VertexesLump& verts, const LineDefLump& lines)
+    {
+        Offsets.clear();
+        Lines.clear();
+        LineLimit = 0;
+
+        int32_t minX = std::numeric_limits<int32_t>::max(), minY = std::numeric_limits<int32_t>::max();
+        int32_t maxX = std::numeric_limits<int32_t>::min(), maxY = std::numeric_limits<int32_t>::min();
+
+        for (size_t i = 0; i < lines.Contents.size(); i++)
+        {
+            const auto line = lines.Contents[i];
+            if (line.Start >= verts.Contents.size() || line.End >= verts.Contents.size())
+                continue;
+
+            for (uint16_t index : { line.Start, line.End })
+            {
+                const auto vertex = verts.Contents[index];
+                minX = std::min<int32_t>(minX, vertex.X);
+                minY = std::min<int32_t>(minY, vertex.Y);
+                maxX = std::max<int32_t>(maxX, vertex.X);
+                maxY = std::max<int32_t>(maxY, vertex.Y);
+            }
+        }
+
+        if (minX > maxX)
+            return;
+
+        OriginX = minX - 8;
+        OriginY = minY - 8;
+        Columns = (maxX - OriginX) / BlockSize + 1;
+        Rows = (maxY - OriginY) / BlockSize + 1;
+
+        // the first pass counts the lines in each block, the second fills them in
+        std::vector<uint32_t> counts(size_t(Columns) * size_t(Rows) + 1, 0);
+
+        auto forEachBlock = [&](auto&& add)
+        {
+            for (size_t i = 0; i < lines.Contents.size(); i++)
+            {
+                const auto line = lines.Contents[i];
+                if (line.Start >= verts.Contents.size() || line.End >= verts.Contents.size())
+                    continue;
+
+                const auto start = verts.Contents[line.Start];
+                const auto end = verts.Contents[line.End];
+
+                int32_t firstColumn = (std::min(start.X, end.X) - OriginX) / BlockSize;
+                int32_t lastColumn = (std::max(start.X, end.X) - OriginX) / BlockSize;
+                int32_t firstRow = (std::min(start.Y, end.Y) - OriginY) / BlockSize;
+                int32_t lastRow = (std::max(start.Y, end.Y) - OriginY) / BlockSize;
+
+                bool straight = firstColumn == lastColumn || firstRow == lastRow;
+
+                for (int32_t row = firstRow; row <= lastRow; row++)
+                {
+                    for (int32_t column = firstColumn; column <= lastColumn; column++)
+                    {
+                        if (straight || LineTouchesBlock(start.X, start.Y, end.X, end.Y, OriginX + column * BlockSize, OriginY + row * BlockSize, BlockSize))
+                            add(size_t(row) * Columns + column, uint32_t(i));
+                    }
+                }
+            }
+        };
+
+        forEachBlock([&](size_t block, uint32_t line) { counts[block + 1]++; });
+
+        Offsets.resize(counts.size());
+        for (size_t i = 1; i < counts.size(); i++)
+            Offsets[i] = Offsets[i - 1] + counts[i];
+
+        Lines.resize(Offsets.back());
+
+        std::vector<uint32_t> next(Offsets.begin(), Offsets.end() - 1);
+        forEachBlock([&](size_t block, uint32_t line) { Lines[next[block]++] = line; });
+
+        LineLimit = uint32_t(lines.Contents.size());
+    }
+
+    const uint32_t* BlockMapLump::GetBlockLines(int32_t column, int32_t row, size_t& count) const
+    {
+        count = 0;
+        if (column < 0 || row < 0 || column >= Columns || row >= Rows || Offsets.empty())
+            return nullptr;
+
+        size_t block = size_t(row) * Columns + column;
+        count = Offsets[block + 1] - Offsets[block];
+        return Lines.data() + Offsets[block];
+    }
+
+    int32_t BlockMapLump::GetColumn(double x) const
+    {
+        return int32_t(std::floor((x - OriginX) / BlockSize));
+    }
+
+    int32_t BlockMapLump::GetRow(double y) const
+    {
+        return int32_t(std::floor((y - OriginY) / BlockSize));
+    }
+
+    bool BlockMapLump::ForEachLineInBox(double minX, double minY, double maxX, double maxY, const std::function<bool(size_t lineIndex)>& visit) const
+    {
+        if (!IsValid())
+            return true;
+
+        int32_t firstColumn = std::max(GetColumn(minX), 0);
+        int32_t lastColumn = std::min(GetColumn(maxX), Columns - 1);
+        int32_t firstRow = std::max(GetRow(minY), 0);
+        int32_t lastRow = std::min(GetRow(maxY), Rows - 1);
+
+        Visited.Begin(LineLimit);
+
+        for (int32_t row = firstRow; row <= lastRow; row++)
+        {
+            for (int32_t column = firstColumn; column <= lastColumn; column++)
+            {
+                size_t count = 0;
+                const uint32_t* lines = GetBlockLines(column, row, count);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (Visited.Visit(lines[i]) && !visit(lines[i]))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool BlockMapLump::ForEachLineAlongSegment(double startX, double startY, double endX, double endY, const std::function<bool(size_t lineIndex)>& visit) const
+    {
+        if (!IsValid())
+            return true;
+
+        Visited.Begin(LineLimit);
+
+        auto visitBlock = [&](int32_t column, int32_t row)
+        {
+            size_t count = 0;
+            const uint32_t* lines = GetBlockLines(column, row, count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (Visited.Visit(lines[i]) && !visit(lines[i]))
+                    return false;
+            }
+            return true;
+        };
+
+        if (!std::isfinite(startX) || !std::isfinite(startY) || !std::isfinite(endX) || !std::isfinite(endY))
+            return true;
+
+        // walks the grid cell by cell along the segment, in block units
+        double x0 = (startX - OriginX) / BlockSize;
+        double y0 = (startY - OriginY) / BlockSize;
+        double dx = (endX - startX) / BlockSize;
+        double dy = (endY - startY) / BlockSize;
+
+        // only the part of the segment over the grid is walked, so the work is bounded by the grid however far off it the ends are
+        double tStart = 0;
+        double tEnd = 1;
+        double starts[2] = { x0, y0 };
+        double deltas[2] = { dx, dy };
+        double sizes[2] = { double(Columns), double(Rows) };
+
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (deltas[axis] == 0)
+            {
+                if (starts[axis] < 0 || starts[axis] > sizes[axis])
+                    return true;
+                continue;
+            }
+
+            double enter = -starts[axis] / deltas[axis];
+            double leave = (sizes[axis] - starts[axis]) / deltas[axis];
+            if (enter > leave)
+                std::swap(enter, leave);
+
+            tStart = std::max(tStart, enter);
+            tEnd = std::min(tEnd, leave);
+        }
+
+        if (tStart > tEnd)
+            return true;
+
+        x0 += dx * tStart;
+        y0 += dy * tStart;
+        dx *= tEnd - tStart;
+        dy *= tEnd - tStart;
+
+        // a clipped end can sit right on the grid's edge, rounding can put it a hair past it, it still belongs to the edge block
+        auto toBlock = [](double value, int32_t count) { return std::min(std::max(int32_t(std::floor(value)), 0), count - 1); };
+
+        int32_t column = toBlock(x0, Columns);
+        int32_t row = toBlock(y0, Rows);
+        int32_t lastColumn = toBlock(x0 + dx, Columns);
+        int32_t lastRow = toBlock(y0 + dy, Rows);
+
+        int32_t stepColumn = dx > 0 ? 1 : -1;
+        int32_t stepRow = dy > 0 ? 1 : -1;
+
+        constexpr double never = std::numeric_limits<double>::infinity();
+        double nextColumnT = dx != 0 ? ((dx > 0 ? column + 1 - x0 : x0 - column) / std::abs(dx)) : never;
+        double nextRowT = dy != 0 ? ((dy > 0 ? row + 1 - y0 : y0 - row) / std::abs(dy)) : never;
+        double columnStepT = dx != 0 ? 1 / std::abs(dx) : never;
+        double rowStepT = dy != 0 ? 1 / std::abs(dy) : never;
+
+        size_t steps = size_t(std::abs(lastColumn - column)) + size_t(std::abs(lastRow - row));
+
+        for (size_t i = 0; i <= steps; i++)
+        {
+            if (!visitBlock(column, row))
+                return false;
+
+            if (column == lastColumn && row == lastRow)
+                break;
+
+            if (nextColumnT < nextRowT)
+            {
+                column += stepColumn;
+                nextColumnT += columnStepT;
+            }
+            else if (nextRowT < nextColumnT)
+            {
+                row += stepRow;
+                nextRowT += rowStepT;
+            }
+            else
+            {
+                // straight through a corner, the blocks on either side of it are touched too
+                if (!visitBlock(column + stepColumn, row) || !visitBlock(column, row + stepRow))
+                    return false;
+
+                column += stepColumn;
+                row += stepRow;
+                nextColumnT += columnStepT;
+                nextRowT += rowStepT;
+                i++;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,162 @@
+#include "directory_index.h"
+
+namespace WADData
+{
+    // F_START, FF_START, F1_START and friends open a namespace, the matching _END closes it
+    static LumpNamespace GetMarkerNamespace(WadName name, bool& isStart)
+    {
+        size_t prefixLength = 0;
+
+        isStart = name.EndsWith("_START");
+        if (isStart)
+            prefixLength = name.Length() - 6;
+        else if (name.EndsWith("_END"))
+            prefixLength = name.Length() - 4;
+        else
+            return LumpNamespace::Global;
+
+        if (prefixLength == 0 || prefixLength > 2)
+            return LumpNamespace::Global;
+
+        char letter = name[0];
+        if (prefixLength == 2 && name[1] != letter && (name[1] < '0' || name[1] > '9'))
+            return LumpNamespace::Global;
+
+        switch (letter)
+        {
+        case 'F':
+            return LumpNamespace::Flats;
+        case 'P':
+            return LumpNamespace::Patches;
+        case 'S':
+            return LumpNamespace::Sprites;
+        default:
+            return LumpNamespace::Global;
+        }
+    }
+
+    void DirectoryIndex::Clear()
+    {
+        Entries.clear();
+        Replaced.clear();
+
+        for (size_t space = 0; space < size_t(LumpNamespace::Count); space++)
+        {
+            Ranges[space] = Range();
+            Lookup[space].clear();
+        }
+    }
+
+    void DirectoryIndex::Build(const std::vector<DirectoryEntry>& entries)
+    {
+        Clear();
+
+        // classify every entry, markers nest (F1_START inside F_START) so track the depth of each namespace
+        std::vector<LumpNamespace> spaces(entries.size(), LumpNamespace::Global);
+
+        int depth[size_t(LumpNamespace::Count)] = { 0 };
+        const WADReader::LumpSource* archive = nullptr;
+
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const auto& entry = entries[i];
+
+            if (entry.Source != archive)
+            {
+                archive = entry.Source;
+                for (auto& value : depth)
+                    value = 0;
+            }
+
+            bool isStart = false;
+            LumpNamespace marker = GetMarkerNamespace(entry.Name, isStart);
+
+            if (marker != LumpNamespace::Global && entry.LumpSize == 0)
+            {
+                int& markerDepth = depth[size_t(marker)];
+                if (isStart)
+                    markerDepth++;
+                else if (markerDepth > 0)
+                    markerDepth--;
+
+                // the markers themselves stay findable in the global namespace
+                continue;
+            }
+
+            for (size_t space = size_t(LumpNamespace::Count) - 1; space > 0; space--)
+            {
+                if (depth[space] > 0)
+                {
+                    spaces[i] = LumpNamespace(space);
+                    break;
+                }
+            }
+        }
+
+        // group the entries so each namespace is contiguous
+        for (LumpNamespace space : spaces)
+            Ranges[size_t(space)].Count++;
+
+        uint32_t start = 0;
+        uint32_t cursor[size_t(LumpNamespace::Count)] = { 0 };
+        for (size_t space = 0; space < size_t(LumpNamespace::Count); space++)
+        {
+            Ranges[space].Start = start;
+            cursor[space] = start;
+            start += Ranges[space].Count;
+        }
+
+        Entries.resize(entries.size());
+        Replaced.resize(entries.size(), InvalidIndex);
+
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            size_t space = size_t(spaces[i]);
+            uint32_t index = cursor[space]++;
+
+            Entries[index] = entries[i];
+
+            uint32_t& winner = Lookup[space][entries[i].Name];
+            if (winner != 0)
+                Replaced[index] = winner - 1;
+
+            // stored one based, so a default constructed value means no entry yet
+            winner = index + 1;
+        }
+    }
+
+    uint32_t DirectoryIndex::FindIndex(LumpNamespace space, WadName name) const
+    {
+        const uint32_t* index = Lookup[size_t(space)].Find(name);
+        if (!index)
+            return InvalidIndex;
+
+        return *index - 1;
+    }
+
+    const DirectoryEntry* DirectoryIndex::Find(LumpNamespace space, WadName name) const
+    {
+        uint32_t index = FindIndex(space, name);
+        if (index == InvalidIndex)
+            return nullptr;
+
+        return &Entries[index];
+    }
+
+    Span<const DirectoryEntry> DirectoryIndex::GetNamespace(LumpNamespace space) const
+    {
+        const Range& range = Ranges[size_t(space)];
+        return Span<const DirectoryEntry>(Entries.data() + range.Start, range.Count);
+    }
+
+    LumpNamespace DirectoryIndex::GetNamespaceOf(uint32_t index) const
+    {
+        for (size_t space = 0; space < size_t(LumpNamespace::Count); space++)
+        {
+            if (index >= Ranges[space].Start && index < Ranges[space].Start + Ranges[space].Count)
+                return LumpNamespace(space);
+        }
+
+        return LumpNamespace::Global;
+    }
+}
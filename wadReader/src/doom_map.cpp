@@ -1,9 +1,17 @@
 #include "doom_map.h"
 
 #include "reader.h"
+#include "parallel.h"
+#include "level_cache.h"
+#include "node_builder.h"
 #include "raymath.h"
 
-bool IsMapLump(const std::string& name)
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+
+bool IsMapLump(WADData::WadName name)
 {
 	if (name == WADData::THINGS)
 		return true;
@@ -37,23 +45,107 @@ bool IsMapLump(const std::string& name)
 	if (name == WADData::GL_PVS)
 		return true;
 
-	if (name.substr(0, 3) == "GL_")
+	if (name.StartsWith("GL_"))
+		return true;
+
+	if (name == WADData::ZNODES)
+		return true;
+
+	if (name == WADData::TEXTMAP)
+		return true;
+	if (name == WADData::ENDMAP)
+		return true;
+	if (name == WADData::BEHAVIOR)
+		return true;
+	if (name == WADData::DIALOGUE)
+		return true;
+	if (name == WADData::SCRIPTS)
 		return true;
 
 	return false;
 }
 
+void WADFile::CloseFile()
+{
+	ClearImageCaches();
+
+	Levels.clear();
+	LevelIndex.clear();
+	LumpDB = LumpDatabase();
+	TextureLumps.clear();
+	TextureIndex.clear();
+	TextureLumpsLoaded = false;
+
+	Directory.Clear();
+	RawDirectory.clear();
+
+	TextureNames.Clear();
+	FlatNames.Clear();
+
+	Sources.clear();
+	SourceNames.clear();
+	BufferData = nullptr;
+}
+
+void WADFile::ClearImageCaches()
+{
+	for (auto& image : Flats)
+	{
+		if (image.data)
+			UnloadImage(image);
+	}
+	for (auto& [name, patch] : Patches)
+		UnloadImage(patch.PixelData);
+	for (auto& image : Textures)
+	{
+		if (image.data)
+			UnloadImage(image);
+	}
+
+	Flats.clear();
+	Patches.clear();
+	Textures.clear();
+}
+
 void WADFile::Read(const char* fileName)
 {
-	if (BufferData)
-		UnloadFileData(BufferData);
+	CloseFile();
 
-	int size = 0;
-	BufferData = LoadFileData(fileName, &size);
+	if (MountArchive(fileName))
+		BuildDirectory();
+}
 
-	auto rawDirectory = WADReader::ReadDirectoryEntries(BufferData);
+void WADFile::BuildDirectory()
+{
+	Directory.Build(RawDirectory);
 
-	Levels.clear();
+	// mounting dropped every cached image, the levels that are already loaded won't load again to put theirs back
+	for (auto& level : Levels)
+	{
+		if (level.IsLoaded())
+			level.CacheImages();
+	}
+}
+
+bool WADFile::MountArchive(const char* fileName)
+{
+	auto source = WADReader::CreateLumpSource(SourceType, StreamingBudget);
+	if (!source->Open(fileName))
+	{
+		if (SourceType != WADReader::LumpSourceType::Mapped)
+			return false;
+
+		source = WADReader::CreateLumpSource(WADReader::LumpSourceType::Heap);
+		if (!source->Open(fileName))
+			return false;
+	}
+
+	if (Sources.empty())
+		BufferData = source->GetBuffer();
+
+	auto rawDirectory = WADReader::ReadDirectoryEntries(*source);
+
+	std::vector<LevelMap> newLevels;
 
 	LevelMap map(*this);
 	bool inMap = false;
@@ -63,19 +155,17 @@ void WADFile::Read(const char* fileName)
 	{
 		bool add = true;
 
-		if (!IsMapLump(entry.Name))
-			Entries[entry.Name] = entry;
-
-		if (entry.LumpSize == 0)
+		// a map lump can be empty, XGLN nodes leave SEGS and NODES with nothing in them
+		if (entry.LumpSize == 0 && !(inMap && IsMapLump(entry.Name)))
 		{
 			if (inMap)
 			{
 				if (map.Entries.size() > 0)
-					Levels.push_back(map);
+					newLevels.push_back(map);
 				map.Name.clear();
 				map.Entries.clear();
 			}
-			map.Name = entry.Name;
+			map.Name = entry.Name.ToString();
 			inMap = true;
 		}
 		else
@@ -87,73 +177,645 @@ void WADFile::Read(const char* fileName)
 				{
 					map.Entries[entry.Name] = entry;
 					skip = true;
+
+					// UDMF maps say where they end
+					if (entry.Name == WADData::ENDMAP)
+					{
+						newLevels.push_back(map);
+						map.Name.clear();
+						map.Entries.clear();
+						inMap = false;
+					}
 				}
 				else
 				{
 					if (map.Entries.size() > 0)
-						Levels.push_back(map);
+						newLevels.push_back(map);
 					map.Name.clear();
 					map.Entries.clear();
 					inMap = false;
 				}
 			}
 
+			// nothing is parsed here, lumps are parsed the first time something asks for them
 			if (!skip)
+				LumpDB.AddEntry(entry);
+		}
+	}
+
+	if (inMap && map.Entries.size() > 0)
+		newLevels.push_back(map);
+
+	// a level in a later archive replaces the whole level with the same name, in the same slot
+	if (!newLevels.empty())
+	{
+		std::vector<size_t> replacements(Levels.size(), size_t(-1));
+		std::vector<size_t> additions;
+
+		for (size_t i = 0; i < newLevels.size(); i++)
+		{
+			size_t* existing = LevelIndex.Find(WADData::WadName(newLevels[i].Name));
+			if (existing)
+				replacements[*existing] = i;
+			else
+				additions.push_back(i);
+		}
+
+		// levels hold a reference to their WAD so they can't be assigned, the list is rebuilt instead
+		std::vector<LevelMap> merged;
+		merged.reserve(Levels.size() + additions.size());
+
+		for (size_t i = 0; i < Levels.size(); i++)
+		{
+			if (replacements[i] != size_t(-1))
+				merged.push_back(newLevels[replacements[i]]);
+			else
+				merged.push_back(Levels[i]);
+		}
+
+		for (size_t i : additions)
+		{
+			LevelIndex.Insert(WADData::WadName(newLevels[i].Name), merged.size());
+			merged.push_back(newLevels[i]);
+		}
+
+		Levels.swap(merged);
+	}
+
+	RawDirectory.insert(RawDirectory.end(), rawDirectory.begin(), rawDirectory.end());
+
+	Sources.push_back(std::move(source));
+	SourceNames.push_back(fileName);
+
+	ClearImageCaches();
+	TextureLumps.clear();
+	TextureIndex.clear();
+	TextureLumpsLoaded = false;
+
+	return true;
+}
+
+WADFile::LevelMap* WADFile::FindLevel(WADData::WadName name)
+{
+	size_t* index = LevelIndex.Find(name);
+	if (!index)
+		return nullptr;
+
+	return &Levels[*index];
+}
+
+bool WADFile::LevelMap::SubSectorContains(size_t subSectorID, Vector2 point) const
+{
+	const auto& subSector = GLSubSectors->Contents[subSectorID];
+	if (subSector.Count < 3 || subSector.StartSegment + subSector.Count > GLSegStarts.size())
+		return false;
+
+	// subsectors are convex, the point is inside when it is on the same side of every seg, points on a seg count as inside
+	bool anyLeft = false;
+	bool anyRight = false;
+	for (size_t i = subSector.StartSegment; i < subSector.StartSegment + subSector.Count; i++)
+	{
+		Vector2 sp = Vertices.Get(GLSegStarts[i]);
+		Vector2 ep = Vertices.Get(GLSegEnds[i]);
+
+		float edgeX = ep.x - sp.x;
+		float edgeY = ep.y - sp.y;
+		float side = edgeX * (point.y - sp.y) - edgeY * (point.x - sp.x);
+		float tolerance = 1e-4f * (fabsf(edgeX) + fabsf(edgeY));
+
+		anyLeft |= side > tolerance;
+		anyRight |= side < -tolerance;
+		if (anyLeft && anyRight)
+			return false;
+	}
+
+	return true;
+}
+
+uint32_t WADFile::LevelMap::StepLookupNode(uint32_t child, Vector2 point, uint32_t& untakenChild) const
+{
+	const auto& node = LookupNodes[child];
+
+	float dx = point.x - node.PartitionStart.x;
+	float dy = point.y - node.PartitionStart.y;
+	float side = dy * node.PartitionVector.x - dx * node.PartitionVector.y;
+
+	int taken = side >= 0 ? 1 : 0;
+	if (fabsf(side) <= 1e-4f * (fabsf(node.PartitionVector.x) + fabsf(node.PartitionVector.y)))
+		untakenChild = node.Children[1 - taken];
+
+	return node.Children[taken];
+}
+
+uint32_t WADFile::LevelMap::DescendLookupNodes(uint32_t child, Vector2 point, uint32_t& untakenChild) const
+{
+	// never longer than the tree, so damaged nodes can't loop it
+	for (size_t depth = 0; depth < LookupNodes.size() && !(child & WADData::ExtendedNodesLump::SubSectorChild); depth++)
+		child = StepLookupNode(child, point, untakenChild);
+	return child;
+}
+
+size_t WADFile::LevelMap::ResolveLookupLeaf(uint32_t leaf, Vector2 point, uint32_t untakenChild) const
+{
+	constexpr uint32_t subSectorChild = WADData::ExtendedNodesLump::SubSectorChild;
+
+	// a leaf's region runs on past the edge of the map, the subsector itself says if the point is in the map
+	auto findIn = [&](uint32_t leaf)
+	{
+		if (!(leaf & subSectorChild))
+			return size_t(-1);
+
+		size_t subSectorID = leaf & ~subSectorChild;
+		if (SubSectorPlaces[subSectorID].Sector == uint32_t(-1) || !SubSectorContains(subSectorID, point))
+			return size_t(-1);
+		return subSectorID;
+	};
+
+	size_t subSectorID = findIn(leaf);
+	if (subSectorID == size_t(-1) && untakenChild != uint32_t(-1))
+	{
+		uint32_t unused = uint32_t(-1);
+		subSectorID = findIn(DescendLookupNodes(untakenChild, point, unused));
+	}
+
+	return subSectorID;
+}
+
+size_t WADFile::LevelMap::FindSubSector(Vector2 point, size_t& outSector, size_t& outSectorSubSector) const
+{
+	if (!LookupNodes.empty())
+	{
+		// the root is the last node
+		uint32_t untakenChild = uint32_t(-1);
+		uint32_t leaf = DescendLookupNodes(uint32_t(LookupNodes.size() - 1), point, untakenChild);
+
+		size_t subSectorID = ResolveLookupLeaf(leaf, point, untakenChild);
+		if (subSectorID == size_t(-1))
+			return size_t(-1);
+
+		outSector = SubSectorPlaces[subSectorID].Sector;
+		outSectorSubSector = SubSectorPlaces[subSectorID].Slot;
+		return subSectorID;
+	}
+
+	for (const auto& sector : SectorCache)
+	{
+		for (size_t subSectorIndex = 0; subSectorIndex < sector.SubSectors.size(); subSectorIndex++)
+		{
+			size_t subSectorID = sector.SubSectors[subSectorIndex];
+			if (SubSectorContains(subSectorID, point))
 			{
-				LumpDB.LoadLumpData(entry);
-
-				if (entry.Name == WADData::PLAYPAL)
-					PalettesLump = LumpDB.GetLump<WADData::PlayPalLump>(WADData::PLAYPAL);
-				if (entry.Name == WADData::PNAMES)
-					PatchNames = LumpDB.GetLump<WADData::PatchNamesLump>(WADData::PNAMES);
-				if (entry.Name == WADData::TEXTURE)
-					TextureLumps.push_back(LumpDB.GetLump<WADData::TexturesLump>(WADData::TEXTURE));
-				if (entry.Name == WADData::TEXTURE1)
-					TextureLumps.push_back(LumpDB.GetLump<WADData::TexturesLump>(WADData::TEXTURE1));
-				if (entry.Name == WADData::TEXTURE2)
-					TextureLumps.push_back(LumpDB.GetLump<WADData::TexturesLump>(WADData::TEXTURE2));
+				outSector = sector.SectorIndex;
+				outSectorSubSector = subSectorIndex;
+				return subSectorID;
 			}
 		}
 	}
+
+	return size_t(-1);
 }
 
-size_t WADFile::LevelMap::GetSectorFromPoint(float x, float y, size_t* outSubSector) const
+void WADFile::LevelMap::BuildPointLookup()
 {
-	Vector2 point = { x,y };
+	LookupNodes.clear();
+	SubSectorPlaces.clear();
+	SubSectorNeighbourStarts.clear();
+	SubSectorNeighbours.clear();
+
+	// a thing's tracker does a full lookup the first time it moves
+	ThingTrackers.assign(Things ? Things->Contents.size() : 0, SectorTracker());
 
+	if (!GLSubSectors || GLSegStarts.empty())
+		return;
+
+	size_t subSectorCount = GLSubSectors->Contents.size();
+	SubSectorPlaces.resize(subSectorCount);
 	for (const auto& sector : SectorCache)
 	{
-		size_t subSectorIndex = 0;
+		for (size_t slot = 0; slot < sector.SubSectors.size(); slot++)
+		{
+			size_t subSectorID = sector.SubSectors[slot];
+			if (subSectorID < subSectorCount && SubSectorPlaces[subSectorID].Sector == uint32_t(-1))
+				SubSectorPlaces[subSectorID] = SubSectorPlace{ uint32_t(sector.SectorIndex), uint32_t(slot) };
+		}
+	}
+
+	SectorGrid.Clear();
+	if (SourceWad.SectorGridCellSize > 0)
+	{
+		std::vector<uint32_t> subSectorSectors(subSectorCount);
+		for (size_t i = 0; i < subSectorCount; i++)
+			subSectorSectors[i] = SubSectorPlaces[i].Sector;
 
-		for (size_t subSectorID : sector.SubSectors)
+		if (SectorGrid.Build(Vertices, GLSegStarts, GLSegEnds, *GLSubSectors, subSectorSectors, SourceWad.SectorGridCellSize * WADData::MapScale))
+		{
+			size_t cells = size_t(SectorGrid.GetColumns()) * size_t(SectorGrid.GetRows());
+			TraceLog(LOG_INFO, "WAD: Level %s sector grid %dx%d, %.1f KB, %.1f%% of cells need an exact lookup", Name.c_str(), SectorGrid.GetColumns(), SectorGrid.GetRows(),
+				SectorGrid.GetMemoryUse() / 1024.0, cells ? 100.0 * SectorGrid.GetMixedCount() / cells : 0.0);
+		}
+		else
 		{
-			const auto& subSector = GLSubSectors->Contents[subSectorID];
+			TraceLog(LOG_WARNING, "WAD: Level %s is too big for a sector grid", Name.c_str());
+		}
+	}
+
+	// GL segs name their partner on the other side, built and XNOD segs don't so segs are also matched by their ends
+	std::vector<uint32_t> segSubSectors(GLSegStarts.size(), uint32_t(-1));
+	for (size_t subSectorID = 0; subSectorID < subSectorCount; subSectorID++)
+	{
+		const auto& subSector = GLSubSectors->Contents[subSectorID];
+		for (size_t seg = subSector.StartSegment; seg < subSector.StartSegment + subSector.Count && seg < GLSegStarts.size(); seg++)
+			segSubSectors[seg] = uint32_t(subSectorID);
+	}
+
+	std::unordered_map<uint64_t, uint32_t> segsByEnds;
+	segsByEnds.reserve(GLSegStarts.size());
+	for (size_t seg = 0; seg < GLSegStarts.size(); seg++)
+		segsByEnds[(uint64_t(GLSegStarts[seg]) << 32) | GLSegEnds[seg]] = uint32_t(seg);
+
+	SubSectorNeighbourStarts.reserve(subSectorCount + 1);
+	SubSectorNeighbourStarts.push_back(0);
+	for (size_t subSectorID = 0; subSectorID < subSectorCount; subSectorID++)
+	{
+		const auto& subSector = GLSubSectors->Contents[subSectorID];
+		size_t first = SubSectorNeighbours.size();
 
-			Vector2 origin = GetVertex(GLSegs->Contents[subSector.StartSegment].End, GLSegs->Contents[subSector.StartSegment].EndIsGL);
+		for (size_t seg = subSector.StartSegment; seg < subSector.StartSegment + subSector.Count && seg < GLSegStarts.size(); seg++)
+		{
+			uint32_t neighbour = uint32_t(-1);
 
-			for (size_t i = 1; i < subSector.Count; i++)
+			size_t partner = GLSegs->Contents[seg].PartnerSegIndex;
+			if (partner < segSubSectors.size())
+			{
+				neighbour = segSubSectors[partner];
+			}
+			else
 			{
-				Vector2 sp = GetVertex(GLSegs->Contents[i + subSector.StartSegment].Start, GLSegs->Contents[i + subSector.StartSegment].StartIsGL);
-				Vector2 ep = GetVertex(GLSegs->Contents[i + subSector.StartSegment].End, GLSegs->Contents[i + subSector.StartSegment].EndIsGL);
+				auto reverse = segsByEnds.find((uint64_t(GLSegEnds[seg]) << 32) | GLSegStarts[seg]);
+				if (reverse != segsByEnds.end())
+					neighbour = segSubSectors[reverse->second];
+			}
+
+			if (neighbour == uint32_t(-1) || neighbour == subSectorID || std::find(SubSectorNeighbours.begin() + first, SubSectorNeighbours.end(), neighbour) != SubSectorNeighbours.end())
+				continue;
+
+			SubSectorNeighbours.push_back(neighbour);
+		}
+
+		SubSectorNeighbourStarts.push_back(uint32_t(SubSectorNeighbours.size()));
+	}
+
+	// extended and built nodes lead to their own subsectors, GL_NODES is only kept when GLSubSectors is GL_SSECT
+	const std::vector<WADData::ExtendedNodesLump::Node>* nodes = nullptr;
+	if (ExtendedNodes && GLSubSectors == &ExtendedNodes->GLSubSectors)
+		nodes = &ExtendedNodes->Nodes;
+	else if (GLNodes)
+		nodes = &GLNodes->Contents;
+
+	// a map of one subsector has no nodes, it is tested directly
+	if (!nodes || nodes->empty() || nodes->size() >= WADData::ExtendedNodesLump::SubSectorChild)
+		return;
+
+	LookupNodes.reserve(nodes->size());
+	for (const auto& node : *nodes)
+	{
+		LookupNode packed;
+		packed.PartitionStart = node.PartitionStart;
+		packed.PartitionVector = node.PartitionVector;
+		packed.Children[0] = node.RightChild;
+		packed.Children[1] = node.LeftChild;
+
+		for (uint32_t child : packed.Children)
+		{
+			bool isSubSector = (child & WADData::ExtendedNodesLump::SubSectorChild) != 0;
+			uint32_t index = child & ~WADData::ExtendedNodesLump::SubSectorChild;
+			if (isSubSector ? index >= subSectorCount : index >= nodes->size())
+			{
+				TraceLog(LOG_WARNING, "WAD: Level %s has nodes that don't match its subsectors", Name.c_str());
+				LookupNodes.clear();
+				return;
+			}
+		}
+
+		LookupNodes.push_back(packed);
+	}
+}
+
+size_t WADFile::LevelMap::GetSectorFromPoint(float x, float y, size_t* outSubSector) const
+{
+	size_t gridSector = size_t(-1);
+	if (!outSubSector && GetSectorFromGrid(x, y, gridSector))
+		return gridSector;
+
+	size_t sector = size_t(-1);
+	size_t sectorSubSector = 0;
+	if (FindSubSector(Vector2{ x, y }, sector, sectorSubSector) == size_t(-1))
+		return size_t(-1);
+
+	if (outSubSector)
+		*outSubSector = sectorSubSector;
+	return sector;
+}
+
+size_t WADFile::LevelMap::GetSubSectorFromPoint(float x, float y) const
+{
+	size_t sector = size_t(-1);
+	size_t sectorSubSector = 0;
+	return FindSubSector(Vector2{ x, y }, sector, sectorSubSector);
+}
+
+size_t WADFile::SectorTracker::Update(const LevelMap& map, Vector2 point)
+{
+	if (Map == &map && SubSector < map.SubSectorPlaces.size() && SubSector + 1 < map.SubSectorNeighbourStarts.size())
+	{
+		if (map.SubSectorContains(SubSector, point))
+			return Sector;
+
+		for (uint32_t i = map.SubSectorNeighbourStarts[SubSector]; i < map.SubSectorNeighbourStarts[SubSector + 1]; i++)
+		{
+			uint32_t neighbour = map.SubSectorNeighbours[i];
+			if (map.SubSectorPlaces[neighbour].Sector != uint32_t(-1) && map.SubSectorContains(neighbour, point))
+			{
+				SubSector = neighbour;
+				Sector = map.SubSectorPlaces[neighbour].Sector;
+				return Sector;
+			}
+		}
+	}
+
+	Map = &map;
+	SubSector = map.GetSubSectorFromPoint(point.x, point.y);
+	Sector = SubSector < map.SubSectorPlaces.size() ? map.SubSectorPlaces[SubSector].Sector : size_t(-1);
+	return Sector;
+}
 
-				if (CheckCollisionPointTriangle(point, origin, sp, ep))
+void WADFile::LevelMap::MoveThing(size_t thingIndex, Vector2 position)
+{
+	if (!Things || thingIndex >= Things->Contents.size() || thingIndex >= ThingTrackers.size())
+		return;
+
+	auto& thing = Things->Contents[thingIndex];
+	thing.Position = position;
+	thing.SectorId = ThingTrackers[thingIndex].Update(*this, position);
+
+	ThingTree.Update(uint32_t(thingIndex), WADData::QuadTree::Bounds{ position.x, position.y, position.x, position.y });
+}
+
+// spreads the bits of a bin coordinate out so two can be interleaved into a Z order index
+static uint32_t SpreadBits(uint32_t value)
+{
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+void WADFile::LevelMap::GetSectorsFromPoints(WADData::Span<const Vector2> points, WADData::Span<size_t> outSectors, size_t workerCount) const
+{
+	size_t count = std::min(points.size(), outSectors.size());
+
+	auto locate = [&](size_t i)
+	{
+		size_t sector = size_t(-1);
+		size_t sectorSubSector = 0;
+		FindSubSector(points[i], sector, sectorSubSector);
+		outSectors[i] = sector;
+	};
+
+	// sorting costs more than it saves on a handful of points, such as a level's things
+	constexpr size_t minSortedBatch = 4096;
+	if (count < minSortedBatch)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!GetSectorFromGrid(points[i].x, points[i].y, outSectors[i]))
+				locate(i);
+		}
+		return;
+	}
+
+	// the points are binned on a grid over their own bounds, and the bins are walked in Z order
+	// so consecutive queries go down mostly the same nodes and test the same segs
+	constexpr uint32_t binSide = 64;
+
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y))
+			continue;
+
+		minX = std::min(minX, points[i].x);
+		minY = std::min(minY, points[i].y);
+		maxX = std::max(maxX, points[i].x);
+		maxY = std::max(maxY, points[i].y);
+	}
+
+	float scaleX = maxX > minX ? binSide / (maxX - minX) : 0;
+	float scaleY = maxY > minY ? binSide / (maxY - minY) : 0;
+
+	// points off the grid, or not numbers at all, go in the nearest edge bin
+	auto toBin = [](float value, float min, float scale)
+	{
+		float bin = (value - min) * scale;
+		return bin > 0 ? uint32_t(std::min(bin, float(binSide - 1))) : 0;
+	};
+
+	struct SortedPoint
+	{
+		Vector2 Point;
+		uint32_t Index;
+	};
+
+	// points the sector grid answers are done here and left out of the sort
+	constexpr uint16_t answered = uint16_t(-1);
+
+	std::vector<uint16_t> bins(count);
+	std::vector<uint32_t> binStarts(binSide * binSide + 1, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (GetSectorFromGrid(points[i].x, points[i].y, outSectors[i]))
+		{
+			bins[i] = answered;
+			continue;
+		}
+
+		uint32_t bin = SpreadBits(toBin(points[i].x, minX, scaleX)) | (SpreadBits(toBin(points[i].y, minY, scaleY)) << 1);
+		bins[i] = uint16_t(bin);
+		binStarts[bin + 1]++;
+	}
+
+	for (size_t bin = 1; bin < binStarts.size(); bin++)
+		binStarts[bin] += binStarts[bin - 1];
+
+	// the points are copied in their sorted order, so the lookups read them in order too
+	std::vector<SortedPoint> sorted(binStarts.back());
+	for (size_t i = 0; i < count; i++)
+	{
+		if (bins[i] != answered)
+			sorted[binStarts[bins[i]]++] = SortedPoint{ points[i], uint32_t(i) };
+	}
+
+	// each thread takes runs of the sorted order, so it keeps to one area of the map at a time
+	constexpr size_t runSize = 1024;
+	WADReader::ParallelFor((sorted.size() + runSize - 1) / runSize, [&](size_t run)
+		{
+			size_t end = std::min(sorted.size(), (run + 1) * runSize);
+			size_t i = run * runSize;
+
+			// several walks go down the nodes side by side, so the loads for one don't wait on the others
+			if (!LookupNodes.empty())
+			{
+				constexpr size_t lanes = 8;
+				for (; i + lanes <= end; i += lanes)
 				{
-                    if (outSubSector)
-                        *outSubSector = subSectorIndex;
-                    return sector.SectorIndex;
+					uint32_t children[lanes];
+					uint32_t untakenChildren[lanes];
+					for (size_t lane = 0; lane < lanes; lane++)
+					{
+						children[lane] = uint32_t(LookupNodes.size() - 1);
+						untakenChildren[lane] = uint32_t(-1);
+					}
+
+					for (size_t depth = 0; depth < LookupNodes.size(); depth++)
+					{
+						bool walking = false;
+						for (size_t lane = 0; lane < lanes; lane++)
+						{
+							if (children[lane] & WADData::ExtendedNodesLump::SubSectorChild)
+								continue;
+
+							children[lane] = StepLookupNode(children[lane], sorted[i + lane].Point, untakenChildren[lane]);
+							walking = true;
+						}
+
+						if (!walking)
+							break;
+					}
+
+					for (size_t lane = 0; lane < lanes; lane++)
+					{
+						size_t subSectorID = ResolveLookupLeaf(children[lane], sorted[i + lane].Point, untakenChildren[lane]);
+						outSectors[sorted[i + lane].Index] = subSectorID == size_t(-1) ? size_t(-1) : SubSectorPlaces[subSectorID].Sector;
+					}
 				}
 			}
-		
-			subSectorIndex++;
+
+			for (; i < end; i++)
+			{
+				size_t sector = size_t(-1);
+				size_t sectorSubSector = 0;
+				FindSubSector(sorted[i].Point, sector, sectorSubSector);
+				outSectors[sorted[i].Index] = sector;
+			}
+		}, workerCount);
+}
+
+bool WADFile::LevelMap::ForEachLineInBox(const Rectangle& box, const std::function<bool(size_t lineIndex)>& visit) const
+{
+	if (!BlockMap)
+		return true;
+
+	// the grid is in map units
+	return BlockMap->ForEachLineInBox(box.x / WADData::MapScale, box.y / WADData::MapScale, (box.x + box.width) / WADData::MapScale, (box.y + box.height) / WADData::MapScale, visit);
+}
+
+bool WADFile::LevelMap::ForEachLineAlongSegment(Vector2 start, Vector2 end, const std::function<bool(size_t lineIndex)>& visit) const
+{
+	if (!BlockMap)
+		return true;
+
+	return BlockMap->ForEachLineAlongSegment(start.x / WADData::MapScale, start.y / WADData::MapScale, end.x / WADData::MapScale, end.y / WADData::MapScale, visit);
+}
+
+void WADFile::LevelMap::BuildQuadTrees()
+{
+	LineTree.Clear();
+	SubSectorTree.Clear();
+	ThingTree.Clear();
+
+	std::vector<WADData::QuadTree::Bounds> bounds;
+
+	auto boundsOf = [&](uint32_t start, uint32_t end)
+	{
+		WADData::QuadTree::Bounds box;
+		if (start < Vertices.size() && end < Vertices.size())
+		{
+			Vector2 sp = Vertices.Get(start);
+			Vector2 ep = Vertices.Get(end);
+			box = WADData::QuadTree::Bounds{ std::min(sp.x, ep.x), std::min(sp.y, ep.y), std::max(sp.x, ep.x), std::max(sp.y, ep.y) };
+		}
+		return box;
+	};
+
+	if (Lines)
+	{
+		bounds.resize(Lines->Contents.size());
+		for (size_t i = 0; i < Lines->Contents.size(); i++)
+		{
+			const auto line = Lines->Contents[i];
+			bounds[i] = boundsOf(line.Start, line.End);
 		}
+		LineTree.Build(bounds);
 	}
 
-	return size_t(-1);
+	if (GLSubSectors)
+	{
+		bounds.assign(GLSubSectors->Contents.size(), WADData::QuadTree::Bounds());
+		for (size_t i = 0; i < GLSubSectors->Contents.size(); i++)
+		{
+			const auto& subSector = GLSubSectors->Contents[i];
+			for (size_t seg = subSector.StartSegment; seg < subSector.StartSegment + subSector.Count && seg < GLSegStarts.size(); seg++)
+				bounds[i].Add(boundsOf(GLSegStarts[seg], GLSegEnds[seg]));
+		}
+		SubSectorTree.Build(bounds);
+	}
+
+	if (Things)
+	{
+		bounds.resize(Things->Contents.size());
+		for (size_t i = 0; i < Things->Contents.size(); i++)
+		{
+			Vector2 position = Things->Contents[i].Position;
+			bounds[i] = WADData::QuadTree::Bounds{ position.x, position.y, position.x, position.y };
+		}
+		ThingTree.Build(bounds);
+	}
+}
+
+size_t WADFile::LevelMap::FindNearestLines(Vector2 point, float maxDistance, WADData::Span<WADData::QuadTree::Neighbour> out) const
+{
+	if (!Lines)
+		return 0;
+
+	return LineTree.FindNearest(point.x, point.y, maxDistance, out, [&](uint32_t index)
+	{
+		const auto line = Lines->Contents[index];
+		Vector2 sp = Vertices.Get(line.Start);
+		Vector2 ep = Vertices.Get(line.End);
+
+		Vector2 direction = Vector2Subtract(ep, sp);
+		float lengthSquared = Vector2LengthSqr(direction);
+		float t = lengthSquared > 0 ? Clamp(Vector2DotProduct(Vector2Subtract(point, sp), direction) / lengthSquared, 0, 1) : 0;
+
+		return Vector2DistanceSqr(point, Vector2Add(sp, Vector2Scale(direction, t)));
+	});
+}
+
+size_t WADFile::LevelMap::FindNearestLine(Vector2 point, float maxDistance, float* distance) const
+{
+	WADData::QuadTree::Neighbour nearest;
+	if (FindNearestLines(point, maxDistance, WADData::Span<WADData::QuadTree::Neighbour>(&nearest, 1)) == 0)
+		return size_t(-1);
+
+	if (distance)
+		*distance = std::sqrt(nearest.DistanceSquared);
+	return nearest.Index;
 }
 
 void WADFile::LevelMap::FindLeafs(size_t nodeId)
 {
-	const auto& node = Nodes->Contents[nodeId];
+	const auto node = Nodes->Contents[nodeId];
 
 	if (node.RightChild & (1 << 15))
 	{
@@ -179,19 +841,49 @@ void WADFile::LevelMap::FindLeafs(size_t nodeId)
 	}
 }
 
-void WADFile::LevelMap::CacheFlat(const std::string& flatName)
+// true when the image for an ID has been composed, callers hold ImageCacheLock
+static bool IsImageCached(const std::vector<Image>& images, uint16_t id)
+{
+	return id < images.size() && images[id].data != nullptr;
+}
+
+static void InsertImage(std::vector<Image>& images, uint16_t id, const Image& image)
+{
+	if (id >= images.size())
+		images.resize(size_t(id) + 1, Image{ 0 });
+
+	images[id] = image;
+}
+
+void WADFile::LevelMap::CacheFlat(uint16_t flatId)
 {
-	if (SourceWad.Flats.find(flatName) != SourceWad.Flats.end())
+	if (flatId == WADData::NameTable::None)
 		return;
 
-	auto entryItr = SourceWad.Entries.find(flatName);
+	{
+		std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+		if (IsImageCached(SourceWad.Flats, flatId))
+			return;
+	}
+
+	WADData::WadName flatName = SourceWad.FlatNames.GetName(flatId);
+
+	auto* entry = SourceWad.Directory.Find(WADData::LumpNamespace::Flats, flatName);
 
-	if (entryItr == SourceWad.Entries.end() || entryItr->second.LumpSize != 4096)
+	if (!entry || entry->LumpSize != 4096)
 		return;
 
-	uint8_t* data = entryItr->second.BufferData + entryItr->second.LumpOffset;
+	WADReader::LumpData lumpData(*entry);
+	if (!lumpData.Data)
+		return;
+
+	uint8_t* data = lumpData.Data;
 
-	auto& palette = SourceWad.PalettesLump->Contents[0];
+	auto* palettes = SourceWad.GetPalettes();
+	if (!palettes)
+		return;
+
+	auto& palette = palettes->Contents[0];
 
 	Image flatImage = GenImageColor(64, 64, BLANK);
 	for (int y = 0; y < 64; y++)
@@ -205,21 +897,43 @@ void WADFile::LevelMap::CacheFlat(const std::string& flatName)
 			ImageDrawPixel(&flatImage, x, 63-y, imageColr);
 		}
 	}
-	
-	SourceWad.Flats[flatName] = flatImage;
+
+	std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+
+	// another level may have composed the same flat while this one was
+	if (IsImageCached(SourceWad.Flats, flatId))
+		UnloadImage(flatImage);
+	else
+		InsertImage(SourceWad.Flats, flatId, flatImage);
 }
 
-void WADFile::LevelMap::CachePatch(const std::string& patchName)
+void WADFile::LevelMap::CachePatch(WADData::WadName patchName)
 {
-	if (SourceWad.Patches.find(patchName) != SourceWad.Patches.end())
+	{
+		std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+		if (SourceWad.Patches.Contains(patchName))
+			return;
+	}
+
+	// patches are allowed outside of the P_START/P_END markers
+	auto* entry = SourceWad.Directory.Find(WADData::LumpNamespace::Patches, patchName);
+	if (!entry)
+		entry = SourceWad.Directory.Find(WADData::LumpNamespace::Global, patchName);
+
+	if (!entry)
 		return;
 
-	auto entryItr = SourceWad.Entries.find(patchName);
+	WADReader::LumpData lumpData(*entry);
+	if (!lumpData.Data)
+		return;
 
-	if (entryItr == SourceWad.Entries.end())
+	auto* palettes = SourceWad.GetPalettes();
+	if (!palettes)
 		return;
 
-	uint8_t* data = entryItr->second.BufferData + entryItr->second.LumpOffset;
+	auto& palette = palettes->Contents[0];
+
+	uint8_t* data = lumpData.Data;
 	size_t offset = 0;
 
 	uint16_t width = WADReader::ReadUInt16(data, offset);
@@ -230,8 +944,6 @@ void WADFile::LevelMap::CachePatch(const std::string& patchName)
 	patch.YOffset = WADReader::ReadInt16(data, offset);
 	patch.PixelData = GenImageColor(width, height, BLANK);
 
-	auto& palette = SourceWad.PalettesLump->Contents[0];
-
 	std::vector<uint32_t> colOffsets;
 	for (uint16_t x = 0; x < width; x++)
 	{
@@ -263,49 +975,95 @@ void WADFile::LevelMap::CachePatch(const std::string& patchName)
 		}
 	}
 
-	SourceWad.Patches[patchName] = patch;
+	std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+
+	if (SourceWad.Patches.Contains(patchName))
+		UnloadImage(patch.PixelData);
+	else
+		SourceWad.Patches.Insert(patchName, patch);
 }
 
-WADData::TexturesLump::TextureDef* WADFile::LevelMap::FindTexture(const std::string& name)
+WADData::TexturesLump::TextureDef* WADFile::LevelMap::FindTexture(WADData::WadName name)
 {
-	for (auto textureGroupItr = SourceWad.TextureLumps.rbegin(); textureGroupItr != SourceWad.TextureLumps.rend(); textureGroupItr++)
-	{
-		auto textureItr = (*textureGroupItr)->Contents.find(name);
-		if (textureItr != (*textureGroupItr)->Contents.end())
-		{
-			return &textureItr->second;
-		}
-	}
-
-	return nullptr;
+	return SourceWad.FindTexture(name);
 }
 
-void WADFile::LevelMap::CacheTexture(const std::string& textureName)
+void WADFile::LevelMap::CacheTexture(uint16_t textureId)
 {
-	if (SourceWad.Textures.find(textureName) != SourceWad.Textures.end())
+	if (textureId == WADData::NameTable::None)
 		return;
-	
+
+	{
+		std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+		if (IsImageCached(SourceWad.Textures, textureId))
+			return;
+	}
+
+	WADData::WadName textureName = SourceWad.TextureNames.GetName(textureId);
+
 	auto* textureDef = FindTexture(textureName);
 	if (!textureDef)
 		return;
 
+	auto* patchNames = SourceWad.GetPatchNames();
+	if (!patchNames)
+		return;
+
 	Image textureImage = GenImageColor(textureDef->Width, textureDef->Height, BLANK);
 
 	for (const auto& patch : textureDef->Patches)
 	{
-		const std::string& patchName = SourceWad.PatchNames->Contents[patch.PatchId];
+		if (patch.PatchId >= patchNames->Contents.size())
+			continue;
+
+		WADData::WadName patchName = patchNames->Contents[patch.PatchId];
 
 		CachePatch(patchName);
 
-		auto patchItr = SourceWad.Patches.find(patchName);
-		if (patchItr == SourceWad.Patches.end())
-			continue;
-		Rectangle source = { 0, 0, float(patchItr->second.PixelData.width),  float(patchItr->second.PixelData.height) };
+		// cached images are never changed, so a copy of the image handle can be drawn from outside the lock
+		Image patchImage = { 0 };
+		{
+			std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+			auto* patchData = SourceWad.Patches.Find(patchName);
+			if (!patchData)
+				continue;
+
+			patchImage = patchData->PixelData;
+		}
+
+		Rectangle source = { 0, 0, float(patchImage.width),  float(patchImage.height) };
 		Rectangle destination = { float(patch.OriginX), float(patch.OriginY), source.width, source.height };
-		ImageDraw(&textureImage, patchItr->second.PixelData, source, destination, WHITE);
+		ImageDraw(&textureImage, patchImage, source, destination, WHITE);
+	}
+
+	std::lock_guard<std::mutex> lock(SourceWad.ImageCacheLock);
+
+	if (IsImageCached(SourceWad.Textures, textureId))
+		UnloadImage(textureImage);
+	else
+		InsertImage(SourceWad.Textures, textureId, textureImage);
+}
+
+void WADFile::LevelMap::CacheImages()
+{
+	if (Sectors)
+	{
+		for (const auto& sector : Sectors->Contents)
+		{
+			CacheFlat(sector.FloorTexture);
+			CacheFlat(sector.CeilingTexture);
+		}
 	}
 
-	SourceWad.Textures[textureName] = textureImage;
+	if (Sides)
+	{
+		for (const auto& side : Sides->Contents)
+		{
+			CacheTexture(side.LowerTexture);
+			CacheTexture(side.MidTexture);
+			CacheTexture(side.TopTexture);
+		}
+	}
 }
 
 float GetLightFactor(const Vector2& normal)
@@ -320,53 +1078,192 @@ float GetLightFactor(const Vector2& normal)
 	return 0.35f + (dot * 0.75f);
 }
 
-void WADFile::LevelMap::Load()
+void WADFile::LevelMap::Load(size_t workerCount)
 {
-	// we need to load this first since other parsers may read it's version number
-	LumpDB.LoadLumpData(Entries[WADData::GL_VERT]);
+	if (Loaded)
+		return;
 
 	for (auto& [key,entity] : Entries)
-		LumpDB.LoadLumpData(entity);
+		LumpDB.AddEntry(entity);
+
+	// a UDMF map has everything in TEXTMAP, it is read into the lumps a binary map has
+	TextMap = LumpDB.GetLump<WADData::UDMFLump>(WADData::TEXTMAP);
+	if (TextMap)
+	{
+		if (!TextMap->IsValid())
+		{
+			TraceLog(LOG_WARNING, "WAD: Level %s has a TEXTMAP that can't be read", Name.c_str());
+			return;
+		}
+
+		Verts = &TextMap->Verts;
+		Lines = &TextMap->Lines;
+		Things = &TextMap->Things;
+		Sectors = &TextMap->Sectors;
+		Sides = &TextMap->Sides;
+	}
+	else
+	{
+		Verts = LumpDB.GetLump<WADData::VertexesLump>(WADData::VERTEXES);
+		Lines = LumpDB.GetLump<WADData::LineDefLump>(WADData::LINEDEFS);
+		Things = LumpDB.GetLump<WADData::ThingsLump>(WADData::THINGS);
+		Sectors = LumpDB.GetLump<WADData::SectorsLump>(WADData::SECTORS);
+		Sides = LumpDB.GetLump<WADData::SideDefLump>(WADData::SIDEDEFS);
+	}
+
+	// extended nodes sit in ZNODES, or take the place of SSECTORS (XGLN, XGL2, XGL3) or NODES (XNOD), which then can't be read as vanilla lumps
+	WADData::WadName extendedNodesLump;
+	ExtendedNodes = LumpDB.GetLump<WADData::ExtendedNodesLump>(WADData::ZNODES);
+	if (ExtendedNodes)
+	{
+		extendedNodesLump = WADData::ZNODES;
+	}
+	else
+	{
+		for (WADData::WadName name : { WADData::SSECTORS, WADData::NODES })
+		{
+			auto* entry = Entries.Find(name);
+			if (!entry)
+				continue;
+
+			WADReader::LumpData data(*entry);
+			if (WADData::GetExtendedNodeFormat(data.Data, data.Size) == WADData::ExtendedNodeFormat::None)
+				continue;
+
+			ExtendedNodes = LumpDB.LoadLumpDataAs<WADData::ExtendedNodesLump>(*entry, WADData::ZNODES);
+			extendedNodesLump = name;
+			break;
+		}
+	}
+
+	if (ExtendedNodes && (ExtendedNodes->Format == WADData::ExtendedNodeFormat::None || !Verts || ExtendedNodes->OriginalVertexCount > Verts->Positions.size()))
+	{
+		TraceLog(LOG_WARNING, "WAD: Level %s has extended nodes that can't be used", Name.c_str());
+		ExtendedNodes = nullptr;
+	}
 
-	Verts = LumpDB.GetLump<WADData::VertexesLump>(WADData::VERTEXES);
-	Lines = LumpDB.GetLump<WADData::LineDefLump>(WADData::LINEDEFS);
-	Things = LumpDB.GetLump<WADData::ThingsLump>(WADData::THINGS);
-	Sectors = LumpDB.GetLump<WADData::SectorsLump>(WADData::SECTORS);
-	Sides = LumpDB.GetLump<WADData::SideDefLump>(WADData::SIDEDEFS);
 	Segs = LumpDB.GetLump<WADData::SegsLump>(WADData::SEGS);
-	Subsectors = LumpDB.GetLump<WADData::SubSectorsLump>(WADData::SSECTORS);
-	Nodes = LumpDB.GetLump<WADData::NodesLump>(WADData::NODES);
+	if (extendedNodesLump != WADData::SSECTORS)
+		Subsectors = LumpDB.GetLump<WADData::SubSectorsLump>(WADData::SSECTORS);
+	if (extendedNodesLump != WADData::NODES)
+		Nodes = LumpDB.GetLump<WADData::NodesLump>(WADData::NODES);
 
 	GLVerts = LumpDB.GetLump<WADData::GLVertsLump>(WADData::GL_VERT);
 	GLSegs = LumpDB.GetLump<WADData::GLSegsLump>(WADData::GL_SEGS);
 	GLSubSectors = LumpDB.GetLump<WADData::GLSubSectorsLump>(WADData::GL_SSECT);
 
-	SectorCache.resize(Sectors->Contents.size());
+	// GL lumps from a GL node builder win, extended GL nodes fill in for them when they are missing
+	if ((!GLSegs || !GLSubSectors) && ExtendedNodes && ExtendedNodes->IsGL())
+	{
+		GLVerts = &ExtendedNodes->GLVerts;
+		GLSegs = &ExtendedNodes->GLSegs;
+		GLSubSectors = &ExtendedNodes->GLSubSectors;
+	}
 
-	for (size_t sectorIndex = 0; sectorIndex < Sectors->Contents.size(); sectorIndex++)
+	uint64_t sourceHash = 0;
+	if (!SourceWad.LevelCacheFolder.empty())
+		sourceHash = WADReader::HashLevelLumps(Entries);
+
+	// a map with no GL nodes at all gets them built here, they are kept with the baked levels so each map is only built once
+	if ((!GLSegs || !GLSubSectors) && Verts && Lines && Sides)
 	{
-		auto& sector = SectorCache[sectorIndex];
-		sector.SectorIndex = sectorIndex;
-		sector.Tint = Color{ (uint8_t)GetRandomValue(128,255), (uint8_t)GetRandomValue(128,255) , (uint8_t)GetRandomValue(128,255) , 255 };
+		auto* built = new WADData::ExtendedNodesLump();
+
+		bool cached = !SourceWad.LevelCacheFolder.empty() && WADReader::LoadBuiltNodes(*built, SourceWad.LevelCacheFolder.c_str(), sourceHash);
+		if (!cached)
+		{
+			if (WADData::BuildGLNodes(*Verts, *Lines, *Sides, *built, workerCount))
+			{
+				if (!SourceWad.LevelCacheFolder.empty() && !WADReader::SaveBuiltNodes(*built, SourceWad.LevelCacheFolder.c_str(), sourceHash))
+					TraceLog(LOG_WARNING, "WAD: Unable to save built nodes for %s", Name.c_str());
+			}
+			else
+			{
+				delete built;
+				built = nullptr;
+			}
+		}
 
-		CacheFlat(Sectors->Contents[sectorIndex].FloorTexture);
-		CacheFlat(Sectors->Contents[sectorIndex].CeilingTexture);
+		if (built)
+		{
+			ExtendedNodes = LumpDB.AddLump(WADData::ZNODES, built);
+			GLVerts = &ExtendedNodes->GLVerts;
+			GLSegs = &ExtendedNodes->GLSegs;
+			GLSubSectors = &ExtendedNodes->GLSubSectors;
+		}
 	}
 
-	for (const auto& side : Sides->Contents)
+	Reject = LumpDB.GetLump<WADData::RejectLump>(WADData::REJECT);
+	if (SourceWad.GenerateReject && (!Reject || !Reject->HasRejects()) && Lines && Sides && Sectors)
 	{
-		CacheTexture(side.LowerTexture);
-		CacheTexture(side.MidTexture);
-		CacheTexture(side.TopTexture);
+		auto* built = new WADData::RejectLump();
+		built->BuildFromConnectivity(*Lines, *Sides, Sectors->Contents.size());
+		Reject = LumpDB.AddLump(WADData::REJECT, built);
+	}
+
+	// glVIS only runs on glBSP output, so a PVS is only trusted against the GL_SSECT it was made from
+	PVS = LumpDB.GetLump<WADData::GLPVSLump>(WADData::GL_PVS);
+	if (PVS && (!PVS->IsValid() || GLSubSectors != LumpDB.GetLump<WADData::GLSubSectorsLump>(WADData::GL_SSECT)))
+		PVS = nullptr;
+
+	// so are GL_NODES, their leaves are GL_SSECT's subsectors
+	if (GLSubSectors && GLSubSectors == LumpDB.GetLump<WADData::GLSubSectorsLump>(WADData::GL_SSECT))
+		GLNodes = LumpDB.GetLump<WADData::GLNodesLump>(WADData::GL_NODES);
+
+	// a big map can have more blocks than 16 bit offsets reach, its lump can't be trusted so the grid is made from the linedefs instead
+	BlockMap = LumpDB.GetLump<WADData::BlockMapLump>(WADData::BLOCKMAP);
+	if ((!BlockMap || !BlockMap->IsValid() || (Lines && BlockMap->GetLineLimit() > Lines->Contents.size())) && Verts && Lines)
+	{
+		auto* built = new WADData::BlockMapLump();
+		built->Build(*Verts, *Lines);
+		BlockMap = LumpDB.AddLump(WADData::BLOCKMAP, built);
+	}
+
+	Vertices.Build(Verts, GLVerts);
+
+	if (GLSegs)
+	{
+		GLSegStarts.resize(GLSegs->Contents.size());
+		GLSegEnds.resize(GLSegs->Contents.size());
+		for (size_t i = 0; i < GLSegs->Contents.size(); i++)
+		{
+			const auto& seg = GLSegs->Contents[i];
+			GLSegStarts[i] = Vertices.GetIndex(seg.Start, seg.StartIsGL);
+			GLSegEnds[i] = Vertices.GetIndex(seg.End, seg.EndIsGL);
+		}
+	}
+
+	CacheImages();
+
+	// everything below only depends on the map lumps, so it can come from a baked copy made the last time these lumps were loaded
+	if (!SourceWad.LevelCacheFolder.empty() && WADReader::LoadBakedLevel(*this, SourceWad.LevelCacheFolder.c_str(), sourceHash))
+	{
+		BuildPointLookup();
+		BuildQuadTrees();
+		Loaded = true;
+		return;
+	}
+
+	SectorCache.resize(Sectors->Contents.size());
+
+	// GetRandomValue shares one generator, each level has its own so levels can load on different threads
+	std::minstd_rand tintRandom(uint32_t(std::hash<std::string>()(Name)));
+	std::uniform_int_distribution<int> tintRange(128, 255);
+
+	for (size_t sectorIndex = 0; sectorIndex < Sectors->Contents.size(); sectorIndex++)
+	{
+		auto& sector = SectorCache[sectorIndex];
+		sector.SectorIndex = sectorIndex;
+		sector.Tint = Color{ (uint8_t)tintRange(tintRandom), (uint8_t)tintRange(tintRandom) , (uint8_t)tintRange(tintRandom) , 255 };
 	}
 
 	// cache the edges in a sector
 	for (size_t lineIndex = 0; lineIndex < Lines->Contents.size(); lineIndex++)
 	{
-		auto& line = Lines->Contents[lineIndex];
+		const auto line = Lines->Contents[lineIndex];
 
-		auto sp = Verts->Contents[line.Start].Position;
-		auto ep = Verts->Contents[line.End].Position;
+		auto sp = Vertices.Get(line.Start);
+		auto ep = Vertices.Get(line.End);
 
 		if (line.FrontSideDef != WADData::InvalidSideDefIndex)
 		{
@@ -412,50 +1309,198 @@ void WADFile::LevelMap::Load()
 		}
 	}
 
-	for (size_t subSectorId = 0; subSectorId < GLSubSectors->Contents.size(); subSectorId++)
+	// without GL nodes there are no closed subsectors, the sectors are left without any
+	size_t subSectorCount = (GLSegs && GLSubSectors) ? GLSubSectors->Contents.size() : 0;
+	if (subSectorCount == 0)
+		TraceLog(LOG_WARNING, "WAD: Level %s has no GL nodes", Name.c_str());
+
+	for (size_t subSectorId = 0; subSectorId < subSectorCount; subSectorId++)
 	{
 		auto& subsector = GLSubSectors->Contents[subSectorId];
-		auto& firstSeg = GLSegs->Contents[subsector.StartSegment];
-		auto& line = Lines->Contents[firstSeg.LineIndex];
 
-		size_t side = line.FrontSideDef;
-		if (firstSeg.Direction)
-			side = line.BackSideDef;
+		// minisegs have no linedef, the sector comes from the first seg that does
+		for (size_t segIndex = subsector.StartSegment; segIndex < subsector.StartSegment + subsector.Count && segIndex < GLSegs->Contents.size(); segIndex++)
+		{
+			const auto& seg = GLSegs->Contents[segIndex];
+			if (seg.IsMiniSeg() || seg.LineIndex >= Lines->Contents.size())
+				continue;
+
+			const auto line = Lines->Contents[seg.LineIndex];
+
+			size_t side = line.FrontSideDef;
+			if (seg.Direction)
+				side = line.BackSideDef;
+
+			if (side == WADData::InvalidSideDefIndex)
+				break;
 
-		size_t sector = Sides->Contents[side].SectorId;
+			size_t sector = Sides->Contents[side].SectorId;
 
-		SectorCache[sector].SubSectors.push_back(subSectorId);
+			SectorCache[sector].SubSectors.push_back(subSectorId);
+			break;
+		}
 	}
 
-	for (auto& thing : Things->Contents)
+	BuildPointLookup();
+	BuildQuadTrees();
+
+	std::vector<Vector2> thingPositions(Things->Contents.size());
+	std::vector<size_t> thingSectors(Things->Contents.size());
+	for (size_t i = 0; i < Things->Contents.size(); i++)
+		thingPositions[i] = Things->Contents[i].Position;
+
+	GetSectorsFromPoints(thingPositions, thingSectors, workerCount);
+
+	for (size_t i = 0; i < Things->Contents.size(); i++)
+		Things->Contents[i].SectorId = thingSectors[i];
+//	FindLeafs(Nodes->Contents.size()-1);
+
+	if (!SourceWad.LevelCacheFolder.empty())
 	{
-		thing.SectorId = GetSectorFromPoint(thing.Position.x, thing.Position.y);
+		if (!WADReader::SaveBakedLevel(*this, SourceWad.LevelCacheFolder.c_str(), sourceHash))
+			TraceLog(LOG_WARNING, "WAD: Unable to save baked level %s", Name.c_str());
 	}
-//	FindLeafs(Nodes->Contents.size()-1);
+
+	Loaded = true;
+}
+
+void WADFile::LoadLevels(size_t workerCount)
+{
+	std::vector<size_t> levelIndexes;
+	for (size_t i = 0; i < Levels.size(); i++)
+	{
+		if (!Levels[i].IsLoaded())
+			levelIndexes.push_back(i);
+	}
+
+	LoadLevels(levelIndexes, workerCount);
+}
+
+void WADFile::LoadLevels(const std::vector<size_t>& levelIndexes, size_t workerCount)
+{
+	// levels only share the WAD lumps and the image caches, both of which are locked
+	// when they load side by side each one builds its nodes and finds its things' sectors on its own thread, threads starting more threads would give cores times cores of them
+	size_t levelWorkers = std::min(workerCount == 0 ? WADReader::GetDefaultWorkerCount() : workerCount, levelIndexes.size());
+	size_t loadWorkers = levelWorkers > 1 ? 1 : workerCount;
+
+	WADReader::ParallelFor(levelIndexes.size(), [&](size_t i)
+		{
+			size_t levelIndex = levelIndexes[i];
+			if (levelIndex < Levels.size())
+				Levels[levelIndex].Load(loadWorkers);
+		}, levelWorkers);
+}
+
+const std::vector<WADData::TexturesLump*>& WADFile::GetTextureLumps()
+{
+	std::lock_guard<std::recursive_mutex> lock(LumpLock);
+
+	if (!TextureLumpsLoaded)
+	{
+		TextureLumpsLoaded = true;
+
+		for (WADData::WadName name : { WADData::TEXTURE, WADData::TEXTURE1, WADData::TEXTURE2 })
+		{
+			auto* textures = LumpDB.GetLump<WADData::TexturesLump>(name);
+			if (!textures)
+				continue;
+
+			TextureLumps.push_back(textures);
+
+			// the texture lumps are never modified once they are parsed, so pointers into them stay valid
+			for (auto& [textureName, texture] : textures->Contents)
+				TextureIndex.Insert(textureName, &texture);
+		}
+	}
+
+	return TextureLumps;
 }
 
-Vector2 WADFile::LevelMap::GetVertex(size_t index, bool isGLVert) const
+WADData::TexturesLump::TextureDef* WADFile::FindTexture(WADData::WadName name)
 {
-	if (isGLVert)
-		return GLVerts->Contents[index];
+	std::lock_guard<std::recursive_mutex> lock(LumpLock);
 
-	return Verts->Contents[index].Position;
+	GetTextureLumps();
+
+	auto* texture = TextureIndex.Find(name);
+	if (!texture)
+		return nullptr;
+
+	return *texture;
 }
 
-void WADFile::LumpDatabase::LoadLumpData(const WADData::DirectoryEntry& entry)
+void WADFile::LumpDatabase::AddEntry(const WADData::DirectoryEntry& entry)
 {
-	if (Lumps.find(entry.Name) != Lumps.end())
+	// only lumps that have a parser are worth remembering
+	if (!WADData::FindLumpType(entry.Name))
 		return;
 
+	Entries.Insert(entry.Name, entry);
+
+	// anything parsed from the entry this one replaced is stale, it will be parsed again from the new entry
+	// the old lump is not freed since levels and texture groups may still point at it
+	auto* parsed = Lumps.Find(entry.Name);
+	if (parsed)
+		*parsed = nullptr;
+}
+
+WADData::Lump* WADFile::LumpDatabase::LoadLumpData(const WADData::DirectoryEntry& entry)
+{
+	auto* existing = Lumps.Find(entry.Name);
+	if (existing && *existing)
+		return *existing;
+
 	WADData::Lump* lump = WADData::GetLump(entry.Name);
 	if (!lump)
-		return;
+		return nullptr;
+
+	return ParseLump(entry, lump, entry.Name);
+}
 
+WADData::Lump* WADFile::LumpDatabase::ParseLump(const WADData::DirectoryEntry& entry, WADData::Lump* lump, WADData::WadName key)
+{
+	// the GL lumps read their format from the GL_VERT header, so it has to be parsed first
 	int version = 0;
-	auto glVertsLump = Lumps.find(WADData::GL_VERT);
-	if (glVertsLump != Lumps.end())
-		version = ((WADData::GLVertsLump*)glVertsLump->second)->FormatVersion;
+	if (entry.Name != WADData::GL_VERT)
+	{
+		auto* glVertsLump = GetLump<WADData::GLVertsLump>(WADData::GL_VERT);
+		if (glVertsLump)
+			version = glVertsLump->FormatVersion;
+	}
+
+	// REJECT is sized by the sector count
+	size_t sectorCount = 0;
+	if (entry.Name == WADData::REJECT)
+	{
+		auto* sectorsLump = GetLump<WADData::SectorsLump>(WADData::SECTORS);
+		if (sectorsLump)
+			sectorCount = sectorsLump->Contents.size();
+	}
+
+	// and GL_PVS by the GL subsector count
+	size_t subSectorCount = 0;
+	if (entry.Name == WADData::GL_PVS)
+	{
+		auto* glSubSectorsLump = GetLump<WADData::GLSubSectorsLump>(WADData::GL_SSECT);
+		if (glSubSectorsLump)
+			subSectorCount = glSubSectorsLump->Contents.size();
+	}
+
+	auto lumpData = std::make_unique<WADReader::LumpData>(entry);
+	WADData::ParseContext context;
+	context.GLVertsVersion = version;
+	context.SectorCount = sectorCount;
+	context.SubSectorCount = subSectorCount;
+	context.TextureNames = TextureNames;
+	context.FlatNames = FlatNames;
+
+	lump->Parse(lumpData->Data, 0, lumpData->Size, context);
+
+	// lumps that read in place keep their bytes pinned, everything else has copied what it needs
+	if (lump->ReadsInPlace())
+		lump->PinnedData = std::move(lumpData);
+
+	Lumps.Insert(key, lump);
 
-	lump->Parse(entry.BufferData, entry.LumpOffset, entry.LumpSize, version);
-	Lumps.insert_or_assign(entry.Name, lump);
+	return lump;
 }
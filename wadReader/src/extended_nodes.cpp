@@ -0,0 +1,345 @@
+#include "lump_types.h"
+
+#include "reader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace WADData
+{
+    // reads little endian values and fails instead of running off the end of the data
+    class NodeReader
+    {
+    public:
+        NodeReader(const uint8_t* data, size_t size) : Data(data), Size(size) {}
+
+        bool Failed = false;
+
+        const uint8_t* Here() const { return Data + Offset; }
+
+        // true when count records of recordSize bytes are left, so a bad count can't make a huge allocation
+        bool Fits(size_t count, size_t recordSize)
+        {
+            if (Failed || (Size - Offset) / recordSize < count)
+                Failed = true;
+            return !Failed;
+        }
+
+        void Skip(size_t bytes) { Offset += bytes; }
+
+        uint8_t U8() { return Take(1) ? Data[Offset - 1] : 0; }
+        uint16_t U16() { return Take(2) ? LoadUInt16LE(Data + Offset - 2) : 0; }
+        int16_t I16() { return Take(2) ? LoadInt16LE(Data + Offset - 2) : 0; }
+        uint32_t U32() { return Take(4) ? LoadUInt32LE(Data + Offset - 4) : 0; }
+        int32_t I32() { return Take(4) ? LoadInt32LE(Data + Offset - 4) : 0; }
+
+    protected:
+        bool Take(size_t bytes)
+        {
+            if (Failed || Size - Offset < bytes)
+            {
+                Failed = true;
+                return false;
+            }
+
+            Offset += bytes;
+            return true;
+        }
+
+        const uint8_t* Data = nullptr;
+        size_t Size = 0;
+        size_t Offset = 0;
+    };
+
+    ExtendedNodeFormat GetExtendedNodeFormat(const uint8_t* data, size_t size, bool* compressed)
+    {
+        if (compressed)
+            *compressed = false;
+
+        if (!data || size < 4)
+            return ExtendedNodeFormat::None;
+
+        char signature[4];
+        memcpy(signature, data, 4);
+
+        if (signature[0] != 'X' && signature[0] != 'Z')
+            return ExtendedNodeFormat::None;
+
+        ExtendedNodeFormat format = ExtendedNodeFormat::None;
+        if (memcmp(signature + 1, "NOD", 3) == 0)
+            format = ExtendedNodeFormat::XNOD;
+        else if (memcmp(signature + 1, "GLN", 3) == 0)
+            format = ExtendedNodeFormat::XGLN;
+        else if (memcmp(signature + 1, "GL2", 3) == 0)
+            format = ExtendedNodeFormat::XGL2;
+        else if (memcmp(signature + 1, "GL3", 3) == 0)
+            format = ExtendedNodeFormat::XGL3;
+
+        if (compressed && format != ExtendedNodeFormat::None)
+            *compressed = signature[0] == 'Z';
+
+        return format;
+    }
+
+    void ExtendedNodesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        Format = GetExtendedNodeFormat(data + offset, size, &Compressed);
+        if (Format == ExtendedNodeFormat::None)
+            return;
+
+        const uint8_t* body = data + offset + 4;
+        size_t bodySize = size - 4;
+
+        // the Z formats are a zlib stream, raylib inflates the raw deflate data between the 2 byte header and the adler32
+        unsigned char* inflated = nullptr;
+        if (Compressed)
+        {
+            if (bodySize < 2 || (body[0] & 0x0F) != 8 || ((body[0] << 8) | body[1]) % 31 != 0 || bodySize - 2 > size_t(INT32_MAX))
+            {
+                TraceLog(LOG_WARNING, "WAD: Extended nodes are not a zlib stream");
+                Format = ExtendedNodeFormat::None;
+                return;
+            }
+
+            int inflatedSize = 0;
+            inflated = DecompressData(body + 2, int(bodySize - 2), &inflatedSize);
+            if (!inflated)
+            {
+                TraceLog(LOG_WARNING, "WAD: Unable to inflate extended nodes");
+                Format = ExtendedNodeFormat::None;
+                return;
+            }
+
+            body = inflated;
+            bodySize = size_t(inflatedSize);
+        }
+
+        bool valid = ReadNodes(body, bodySize);
+
+        if (inflated)
+            MemFree(inflated);
+
+        if (!valid)
+        {
+            TraceLog(LOG_WARNING, "WAD: Extended nodes are damaged");
+
+            Format = ExtendedNodeFormat::None;
+            OriginalVertexCount = 0;
+            GLVerts.Contents.clear();
+            GLSegs.Contents.clear();
+            GLSubSectors.Contents.clear();
+            Nodes.clear();
+        }
+    }
+
+    bool ExtendedNodesLump::ReadNodes(const uint8_t* data, size_t size)
+    {
+        NodeReader reader(data, size);
+
+        // vertices, as 16.16 fixed point
+        OriginalVertexCount = reader.U32();
+        uint32_t newVertexCount = reader.U32();
+        if (!reader.Fits(newVertexCount, 8))
+            return false;
+
+        GLVerts.Contents.resize(newVertexCount);
+        if (newVertexCount > 0)
+            WADReader::DecodeFixedPairs(reader.Here(), newVertexCount, GLVerts.Contents.data(), MapScale);
+        reader.Skip(size_t(newVertexCount) * 8);
+
+        // subsectors only store their seg count, their segs follow each other in order
+        uint32_t subSectorCount = reader.U32();
+        if (!reader.Fits(subSectorCount, 4))
+            return false;
+
+        GLSubSectors.Contents.resize(subSectorCount);
+
+        uint64_t firstSeg = 0;
+        for (auto& subSector : GLSubSectors.Contents)
+        {
+            subSector.Count = reader.U32();
+            subSector.StartSegment = size_t(firstSeg);
+            firstSeg += subSector.Count;
+        }
+
+        bool wideLines = Format == ExtendedNodeFormat::XGL2 || Format == ExtendedNodeFormat::XGL3;
+        size_t segSize = wideLines ? 13 : 11;
+
+        uint32_t segCount = reader.U32();
+        if (firstSeg != segCount || !reader.Fits(segCount, segSize))
+            return false;
+
+        uint64_t vertexCount = uint64_t(OriginalVertexCount) + newVertexCount;
+
+        GLSegs.Contents.resize(segCount);
+        for (auto& seg : GLSegs.Contents)
+        {
+            uint32_t start = reader.U32();
+            if (start >= vertexCount)
+                return false;
+
+            seg.StartIsGL = start >= OriginalVertexCount;
+            seg.Start = seg.StartIsGL ? start - OriginalVertexCount : start;
+
+            // XNOD stores both ends, the GL formats store the partner seg and end where the next seg in the subsector starts
+            if (Format == ExtendedNodeFormat::XNOD)
+            {
+                uint32_t end = reader.U32();
+                if (end >= vertexCount)
+                    return false;
+
+                seg.EndIsGL = end >= OriginalVertexCount;
+                seg.End = seg.EndIsGL ? end - OriginalVertexCount : end;
+                seg.PartnerSegIndex = size_t(-1);
+            }
+            else
+            {
+                uint32_t partner = reader.U32();
+                seg.PartnerSegIndex = partner == uint32_t(-1) ? size_t(-1) : size_t(partner);
+            }
+
+            if (wideLines)
+            {
+                uint32_t line = reader.U32();
+                seg.LineIndex = line == uint32_t(-1) ? GLSegsLump::MiniSegLine : size_t(line);
+            }
+            else
+            {
+                uint16_t line = reader.U16();
+                seg.LineIndex = line == 0xFFFF ? GLSegsLump::MiniSegLine : size_t(line);
+            }
+
+            seg.Direction = reader.U8();
+        }
+
+        if (IsGL())
+        {
+            for (const auto& subSector : GLSubSectors.Contents)
+            {
+                for (size_t i = 0; i < subSector.Count; i++)
+                {
+                    auto& seg = GLSegs.Contents[subSector.StartSegment + i];
+                    const auto& next = GLSegs.Contents[subSector.StartSegment + (i + 1) % subSector.Count];
+
+                    seg.End = next.Start;
+                    seg.EndIsGL = next.StartIsGL;
+                }
+            }
+        }
+
+        // XGL3 has fixed point partitions, everything else has whole map units
+        bool fixedPartitions = Format == ExtendedNodeFormat::XGL3;
+        size_t nodeSize = fixedPartitions ? 40 : 32;
+
+        uint32_t nodeCount = reader.U32();
+        if (!reader.Fits(nodeCount, nodeSize))
+            return false;
+
+        Nodes.resize(nodeCount);
+        for (auto& node : Nodes)
+        {
+            if (fixedPartitions)
+            {
+                constexpr float fixedScale = MapScale / 65536.0f;
+
+                node.PartitionStart.x = reader.I32() * fixedScale;
+                node.PartitionStart.y = reader.I32() * fixedScale;
+                node.PartitionVector.x = reader.I32() * fixedScale;
+                node.PartitionVector.y = reader.I32() * fixedScale;
+            }
+            else
+            {
+                node.PartitionStart.x = reader.I16() * MapScale;
+                node.PartitionStart.y = reader.I16() * MapScale;
+                node.PartitionVector.x = reader.I16() * MapScale;
+                node.PartitionVector.y = reader.I16() * MapScale;
+            }
+
+            for (int i = 0; i < 4; i++)
+                node.RightBBox[i] = reader.I16();
+            for (int i = 0; i < 4; i++)
+                node.LeftBBox[i] = reader.I16();
+
+            node.RightChild = reader.U32();
+            node.LeftChild = reader.U32();
+
+            for (uint32_t child : { node.RightChild, node.LeftChild })
+            {
+                if ((child & SubSectorChild) ? (child & ~SubSectorChild) >= subSectorCount : child >= nodeCount)
+                    return false;
+            }
+        }
+
+        return !reader.Failed;
+    }
+
+    static void WriteUInt16(std::vector<uint8_t>& output, uint16_t value)
+    {
+        output.push_back(uint8_t(value));
+        output.push_back(uint8_t(value >> 8));
+    }
+
+    static void WriteUInt32(std::vector<uint8_t>& output, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            output.push_back(uint8_t(value >> (i * 8)));
+    }
+
+    // world units back to the 16.16 fixed point map units they were read as
+    static uint32_t ToFixed(float value)
+    {
+        return uint32_t(int32_t(std::lround(double(value) / MapScale * 65536.0)));
+    }
+
+    bool ExtendedNodesLump::WriteXGL3(std::vector<uint8_t>& output) const
+    {
+        if (!IsGL())
+            return false;
+
+        output.clear();
+        output.reserve(16 + GLVerts.Contents.size() * 8 + GLSubSectors.Contents.size() * 4 + GLSegs.Contents.size() * 13 + Nodes.size() * 40);
+
+        output.insert(output.end(), { 'X', 'G', 'L', '3' });
+
+        WriteUInt32(output, OriginalVertexCount);
+        WriteUInt32(output, uint32_t(GLVerts.Contents.size()));
+        for (const auto& vertex : GLVerts.Contents)
+        {
+            WriteUInt32(output, ToFixed(vertex.x));
+            WriteUInt32(output, ToFixed(vertex.y));
+        }
+
+        WriteUInt32(output, uint32_t(GLSubSectors.Contents.size()));
+        for (const auto& subSector : GLSubSectors.Contents)
+            WriteUInt32(output, uint32_t(subSector.Count));
+
+        WriteUInt32(output, uint32_t(GLSegs.Contents.size()));
+        for (const auto& seg : GLSegs.Contents)
+        {
+            WriteUInt32(output, uint32_t(seg.Start + (seg.StartIsGL ? OriginalVertexCount : 0)));
+            WriteUInt32(output, uint32_t(seg.PartnerSegIndex));
+            WriteUInt32(output, uint32_t(seg.LineIndex));
+            output.push_back(uint8_t(seg.Direction));
+        }
+
+        WriteUInt32(output, uint32_t(Nodes.size()));
+        for (const auto& node : Nodes)
+        {
+            WriteUInt32(output, ToFixed(node.PartitionStart.x));
+            WriteUInt32(output, ToFixed(node.PartitionStart.y));
+            WriteUInt32(output, ToFixed(node.PartitionVector.x));
+            WriteUInt32(output, ToFixed(node.PartitionVector.y));
+
+            for (int i = 0; i < 4; i++)
+                WriteUInt16(output, uint16_t(node.RightBBox[i]));
+            for (int i = 0; i < 4; i++)
+                WriteUInt16(output, uint16_t(node.LeftBBox[i]));
+
+            WriteUInt32(output, node.RightChild);
+            WriteUInt32(output, node.LeftChild);
+        }
+
+        return true;
+    }
+}
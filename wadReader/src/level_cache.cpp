@@ -0,0 +1,350 @@
+#include "level_cache.h"
+
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace WADReader
+{
+    static constexpr uint32_t MakeTag(const char tag[5])
+    {
+        return uint32_t(uint8_t(tag[0])) | (uint32_t(uint8_t(tag[1])) << 8) | (uint32_t(uint8_t(tag[2])) << 16) | (uint32_t(uint8_t(tag[3])) << 24);
+    }
+
+    static constexpr uint32_t BakedLevelMagic = MakeTag("DLVB");
+
+    static constexpr uint32_t SectorChunk = MakeTag("SECT");
+    static constexpr uint32_t EdgeChunk = MakeTag("EDGE");
+    static constexpr uint32_t SubSectorChunk = MakeTag("SSEC");
+    static constexpr uint32_t ThingChunk = MakeTag("THNG");
+
+    static constexpr uint32_t InvalidBakedIndex = uint32_t(-1);
+
+    // all records are little endian and padded to 4 bytes, chunk data starts on an 8 byte boundary
+    struct BakedHeader
+    {
+        uint32_t Magic = BakedLevelMagic;
+        uint32_t Version = BakedLevelVersion;
+        uint64_t SourceHash = 0;
+        uint64_t TotalSize = 0;
+        uint32_t ChunkCount = 0;
+        uint32_t Reserved = 0;
+    };
+
+    struct BakedChunk
+    {
+        uint32_t Tag = 0;
+        uint32_t Count = 0;
+        uint64_t Offset = 0;
+    };
+
+    struct BakedSector
+    {
+        uint32_t EdgeStart = 0;
+        uint32_t EdgeCount = 0;
+        uint32_t SubSectorStart = 0;
+        uint32_t SubSectorCount = 0;
+        uint8_t Tint[4] = { 0 };
+    };
+
+    struct BakedEdge
+    {
+        uint32_t Line = 0;
+        uint32_t Side = 0;
+        uint32_t Destination = 0;
+        uint32_t Reverse = 0;
+        float Direction[2] = { 0 };
+        float Normal[2] = { 0 };
+        float LightFactor = 0;
+    };
+
+    static_assert(sizeof(BakedHeader) == 32, "baked header layout changed, bump BakedLevelVersion");
+    static_assert(sizeof(BakedChunk) == 16, "baked chunk layout changed, bump BakedLevelVersion");
+    static_assert(sizeof(BakedSector) == 20, "baked sector layout changed, bump BakedLevelVersion");
+    static_assert(sizeof(BakedEdge) == 36, "baked edge layout changed, bump BakedLevelVersion");
+
+    static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    uint64_t HashLevelLumps(const WADData::WadNameMap<WADData::DirectoryEntry>& entries)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+
+        for (const auto& [name, entry] : entries)
+        {
+            uint64_t nameValue = name.GetValue();
+            uint64_t size = entry.LumpSize;
+            hash = HashBytes(hash, &nameValue, sizeof(nameValue));
+            hash = HashBytes(hash, &size, sizeof(size));
+
+            LumpData lumpData(entry);
+            if (lumpData.Data)
+                hash = HashBytes(hash, lumpData.Data, lumpData.Size);
+        }
+
+        return hash;
+    }
+
+    std::string GetBakedLevelPath(const char* folder, uint64_t sourceHash, const char* extension)
+    {
+        char name[32] = { 0 };
+        snprintf(name, sizeof(name), "%016llx.%.8s", (unsigned long long)sourceHash, extension);
+
+        std::string path = folder;
+        if (!path.empty() && path.back() != '/' && path.back() != '\\')
+            path += '/';
+
+        return path + name;
+    }
+
+    // finds a chunk and checks that its records are inside the file
+    template<class T>
+    static const T* FindChunk(const uint8_t* data, size_t size, const BakedHeader& header, uint32_t tag, uint32_t& count)
+    {
+        const uint8_t* table = data + sizeof(BakedHeader);
+
+        for (uint32_t i = 0; i < header.ChunkCount; i++)
+        {
+            BakedChunk chunk;
+            memcpy(&chunk, table + i * sizeof(BakedChunk), sizeof(BakedChunk));
+
+            if (chunk.Tag != tag)
+                continue;
+
+            if (chunk.Offset % 8 != 0 || chunk.Offset > size || (size - chunk.Offset) / sizeof(T) < chunk.Count)
+                return nullptr;
+
+            count = chunk.Count;
+            return (const T*)(data + chunk.Offset);
+        }
+
+        return nullptr;
+    }
+
+    bool LoadBakedLevel(WADFile::LevelMap& level, const char* folder, uint64_t sourceHash)
+    {
+        if (!level.Sectors || !level.Lines || !level.Sides || !level.Things || !level.GLSubSectors)
+            return false;
+
+        std::string path = GetBakedLevelPath(folder, sourceHash);
+
+        MappedFile file;
+        if (!file.Open(path.c_str()))
+            return false;
+
+        const uint8_t* data = file.GetData();
+        size_t size = file.GetSize();
+
+        BakedHeader header;
+        if (size < sizeof(BakedHeader))
+            return false;
+
+        memcpy(&header, data, sizeof(BakedHeader));
+        if (header.Magic != BakedLevelMagic || header.Version != BakedLevelVersion || header.SourceHash != sourceHash || header.TotalSize != size)
+            return false;
+
+        if ((size - sizeof(BakedHeader)) / sizeof(BakedChunk) < header.ChunkCount)
+            return false;
+
+        uint32_t sectorCount = 0, edgeCount = 0, subSectorCount = 0, thingCount = 0;
+        const BakedSector* sectors = FindChunk<BakedSector>(data, size, header, SectorChunk, sectorCount);
+        const BakedEdge* edges = FindChunk<BakedEdge>(data, size, header, EdgeChunk, edgeCount);
+        const uint32_t* subSectors = FindChunk<uint32_t>(data, size, header, SubSectorChunk, subSectorCount);
+        const uint32_t* things = FindChunk<uint32_t>(data, size, header, ThingChunk, thingCount);
+
+        if (!sectors || !edges || !subSectors || !things)
+            return false;
+
+        if (sectorCount != level.Sectors->Contents.size() || thingCount != level.Things->Contents.size())
+            return false;
+
+        // the hash matched, but a damaged file still shouldn't be able to index out of the level
+        for (uint32_t i = 0; i < sectorCount; i++)
+        {
+            const BakedSector& sector = sectors[i];
+            if (sector.EdgeStart > edgeCount || edgeCount - sector.EdgeStart < sector.EdgeCount)
+                return false;
+            if (sector.SubSectorStart > subSectorCount || subSectorCount - sector.SubSectorStart < sector.SubSectorCount)
+                return false;
+        }
+
+        for (uint32_t i = 0; i < edgeCount; i++)
+        {
+            if (edges[i].Line >= level.Lines->Contents.size() || edges[i].Side >= level.Sides->Contents.size())
+                return false;
+            if (edges[i].Destination != WADData::InvalidSectorIndex && edges[i].Destination >= sectorCount)
+                return false;
+        }
+
+        for (uint32_t i = 0; i < thingCount; i++)
+        {
+            if (things[i] != InvalidBakedIndex && things[i] >= sectorCount)
+                return false;
+        }
+
+        for (uint32_t i = 0; i < subSectorCount; i++)
+        {
+            if (subSectors[i] >= level.GLSubSectors->Contents.size())
+                return false;
+        }
+
+        level.SectorCache.clear();
+        level.SectorCache.resize(sectorCount);
+
+        for (uint32_t sectorIndex = 0; sectorIndex < sectorCount; sectorIndex++)
+        {
+            const BakedSector& baked = sectors[sectorIndex];
+            auto& sector = level.SectorCache[sectorIndex];
+
+            sector.SectorIndex = sectorIndex;
+            sector.Tint = Color{ baked.Tint[0], baked.Tint[1], baked.Tint[2], baked.Tint[3] };
+
+            sector.Edges.resize(baked.EdgeCount);
+            for (uint32_t i = 0; i < baked.EdgeCount; i++)
+            {
+                const BakedEdge& bakedEdge = edges[baked.EdgeStart + i];
+                auto& edge = sector.Edges[i];
+
+                edge.Line = bakedEdge.Line;
+                edge.Reverse = bakedEdge.Reverse != 0;
+                edge.Side = bakedEdge.Side;
+                edge.Destination = bakedEdge.Destination;
+                edge.Direction = Vector2{ bakedEdge.Direction[0], bakedEdge.Direction[1] };
+                edge.Normal = Vector2{ bakedEdge.Normal[0], bakedEdge.Normal[1] };
+                edge.LightFactor = bakedEdge.LightFactor;
+            }
+
+            sector.SubSectors.assign(subSectors + baked.SubSectorStart, subSectors + baked.SubSectorStart + baked.SubSectorCount);
+        }
+
+        for (uint32_t i = 0; i < thingCount; i++)
+            level.Things->Contents[i].SectorId = things[i] == InvalidBakedIndex ? size_t(-1) : size_t(things[i]);
+
+        return true;
+    }
+
+    template<class T>
+    static void AddChunk(std::vector<uint8_t>& blob, std::vector<BakedChunk>& chunks, uint32_t tag, const std::vector<T>& records)
+    {
+        blob.resize((blob.size() + 7) & ~size_t(7));
+
+        BakedChunk chunk;
+        chunk.Tag = tag;
+        chunk.Count = uint32_t(records.size());
+        chunk.Offset = blob.size();
+        chunks.push_back(chunk);
+
+        size_t bytes = records.size() * sizeof(T);
+        blob.resize(blob.size() + bytes);
+        if (bytes > 0)
+            memcpy(blob.data() + chunk.Offset, records.data(), bytes);
+    }
+
+    bool SaveBakedLevel(const WADFile::LevelMap& level, const char* folder, uint64_t sourceHash)
+    {
+        if (!level.Things)
+            return false;
+
+        std::vector<BakedSector> sectors;
+        std::vector<BakedEdge> edges;
+        std::vector<uint32_t> subSectors;
+        std::vector<uint32_t> things;
+
+        sectors.reserve(level.SectorCache.size());
+        for (const auto& sector : level.SectorCache)
+        {
+            BakedSector baked;
+            baked.EdgeStart = uint32_t(edges.size());
+            baked.EdgeCount = uint32_t(sector.Edges.size());
+            baked.SubSectorStart = uint32_t(subSectors.size());
+            baked.SubSectorCount = uint32_t(sector.SubSectors.size());
+            baked.Tint[0] = sector.Tint.r;
+            baked.Tint[1] = sector.Tint.g;
+            baked.Tint[2] = sector.Tint.b;
+            baked.Tint[3] = sector.Tint.a;
+            sectors.push_back(baked);
+
+            for (const auto& edge : sector.Edges)
+            {
+                BakedEdge bakedEdge;
+                bakedEdge.Line = uint32_t(edge.Line);
+                bakedEdge.Side = uint32_t(edge.Side);
+                bakedEdge.Destination = uint32_t(edge.Destination);
+                bakedEdge.Reverse = edge.Reverse ? 1 : 0;
+                bakedEdge.Direction[0] = edge.Direction.x;
+                bakedEdge.Direction[1] = edge.Direction.y;
+                bakedEdge.Normal[0] = edge.Normal.x;
+                bakedEdge.Normal[1] = edge.Normal.y;
+                bakedEdge.LightFactor = edge.LightFactor;
+                edges.push_back(bakedEdge);
+            }
+
+            for (size_t subSector : sector.SubSectors)
+                subSectors.push_back(uint32_t(subSector));
+        }
+
+        things.reserve(level.Things->Contents.size());
+        for (const auto& thing : level.Things->Contents)
+            things.push_back(thing.SectorId == size_t(-1) ? InvalidBakedIndex : uint32_t(thing.SectorId));
+
+        constexpr uint32_t chunkCount = 4;
+
+        std::vector<uint8_t> blob(sizeof(BakedHeader) + sizeof(BakedChunk) * chunkCount);
+        std::vector<BakedChunk> chunks;
+
+        AddChunk(blob, chunks, SectorChunk, sectors);
+        AddChunk(blob, chunks, EdgeChunk, edges);
+        AddChunk(blob, chunks, SubSectorChunk, subSectors);
+        AddChunk(blob, chunks, ThingChunk, things);
+
+        BakedHeader header;
+        header.SourceHash = sourceHash;
+        header.TotalSize = blob.size();
+        header.ChunkCount = uint32_t(chunks.size());
+
+        memcpy(blob.data(), &header, sizeof(BakedHeader));
+        memcpy(blob.data() + sizeof(BakedHeader), chunks.data(), chunks.size() * sizeof(BakedChunk));
+
+        if (!DirectoryExists(folder))
+            MakeDirectory(folder);
+
+        std::string path = GetBakedLevelPath(folder, sourceHash);
+        return SaveFileData(path.c_str(), blob.data(), int(blob.size()));
+    }
+
+    bool LoadBuiltNodes(WADData::ExtendedNodesLump& nodes, const char* folder, uint64_t sourceHash)
+    {
+        std::string path = GetBakedLevelPath(folder, sourceHash, "xgl3");
+
+        MappedFile file;
+        if (!file.Open(path.c_str()))
+            return false;
+
+        // the parser checks every count and index, a damaged file comes back with no format
+        nodes.Parse(file.GetData(), 0, file.GetSize(), WADData::ParseContext());
+        return nodes.IsGL();
+    }
+
+    bool SaveBuiltNodes(const WADData::ExtendedNodesLump& nodes, const char* folder, uint64_t sourceHash)
+    {
+        std::vector<uint8_t> blob;
+        if (!nodes.WriteXGL3(blob))
+            return false;
+
+        if (!DirectoryExists(folder))
+            MakeDirectory(folder);
+
+        std::string path = GetBakedLevelPath(folder, sourceHash, "xgl3");
+        return SaveFileData(path.c_str(), blob.data(), int(blob.size()));
+    }
+}
@@ -0,0 +1,226 @@
+#include "lump_source.h"
+
+#include <cstring>
+
+namespace WADReader
+{
+    bool LumpSource::Read(size_t offset, size_t size, uint8_t* destination)
+    {
+        uint8_t* buffer = GetBuffer();
+        if (!buffer || offset + size > GetSize())
+            return false;
+
+        memcpy(destination, buffer + offset, size);
+        return true;
+    }
+
+    uint8_t* LumpSource::AcquireLump(const WADData::DirectoryEntry& entry)
+    {
+        uint8_t* buffer = GetBuffer();
+        if (!buffer || entry.LumpOffset + entry.LumpSize > GetSize())
+            return nullptr;
+
+        return buffer + entry.LumpOffset;
+    }
+
+    HeapLumpSource::~HeapLumpSource()
+    {
+        Close();
+    }
+
+    bool HeapLumpSource::Open(const char* fileName)
+    {
+        Close();
+
+        int size = 0;
+        Data = LoadFileData(fileName, &size);
+        Size = Data ? size_t(size) : 0;
+
+        return Data != nullptr;
+    }
+
+    void HeapLumpSource::Close()
+    {
+        if (Data)
+            UnloadFileData(Data);
+
+        Data = nullptr;
+        Size = 0;
+    }
+
+    bool StreamingLumpSource::Open(const char* fileName)
+    {
+        Close();
+        return File.Open(fileName);
+    }
+
+    void StreamingLumpSource::Close()
+    {
+        std::lock_guard<std::mutex> guard(Lock);
+
+        File.Close();
+        Cache.clear();
+        LeastRecentlyUsed.clear();
+        Pool.clear();
+        ResidentBytes = 0;
+    }
+
+    bool StreamingLumpSource::Read(size_t offset, size_t size, uint8_t* destination)
+    {
+        return File.Read(offset, size, destination);
+    }
+
+    uint8_t* StreamingLumpSource::AcquireLump(const WADData::DirectoryEntry& entry)
+    {
+        if (entry.LumpSize == 0 || entry.LumpOffset + entry.LumpSize > File.GetSize())
+            return nullptr;
+
+        LumpKey key = { entry.LumpOffset, entry.LumpSize };
+
+        std::lock_guard<std::mutex> guard(Lock);
+
+        auto itr = Cache.find(key);
+        if (itr != Cache.end())
+        {
+            if (itr->second.Pins == 0)
+                LeastRecentlyUsed.erase(itr->second.Unused);
+
+            itr->second.Pins++;
+            return itr->second.Storage.Data.get();
+        }
+
+        // make room by recycling the buffers of the least recently used lumps
+        while (ResidentBytes + entry.LumpSize > ResidentBudget && !LeastRecentlyUsed.empty() && !HasPooledBuffer(entry.LumpSize))
+            EvictLeastRecentlyUsed();
+
+        Buffer storage = TakeBuffer(entry.LumpSize);
+        TrimTo(ResidentBudget);
+
+        if (!File.Read(entry.LumpOffset, entry.LumpSize, storage.Data.get()))
+        {
+            Pool.push_back(std::move(storage));
+            TrimTo(ResidentBudget);
+            return nullptr;
+        }
+
+        CachedLump& lump = Cache[key];
+        lump.Storage = std::move(storage);
+        lump.Pins = 1;
+
+        return lump.Storage.Data.get();
+    }
+
+    void StreamingLumpSource::ReleaseLump(const WADData::DirectoryEntry& entry)
+    {
+        std::lock_guard<std::mutex> guard(Lock);
+
+        auto itr = Cache.find(LumpKey{ entry.LumpOffset, entry.LumpSize });
+        if (itr == Cache.end() || itr->second.Pins == 0)
+            return;
+
+        itr->second.Pins--;
+        if (itr->second.Pins == 0)
+            itr->second.Unused = LeastRecentlyUsed.insert(LeastRecentlyUsed.end(), itr->first);
+
+        TrimTo(ResidentBudget);
+    }
+
+    void StreamingLumpSource::SetResidentBudget(size_t budget)
+    {
+        std::lock_guard<std::mutex> guard(Lock);
+
+        ResidentBudget = budget;
+        TrimTo(ResidentBudget);
+    }
+
+    StreamingLumpSource::Buffer StreamingLumpSource::TakeBuffer(size_t size)
+    {
+        // reuse the smallest pooled buffer that fits
+        size_t best = Pool.size();
+        for (size_t i = 0; i < Pool.size(); i++)
+        {
+            if (Pool[i].Capacity >= size && (best == Pool.size() || Pool[i].Capacity < Pool[best].Capacity))
+                best = i;
+        }
+
+        if (best != Pool.size())
+        {
+            Buffer buffer = std::move(Pool[best]);
+            Pool[best] = std::move(Pool.back());
+            Pool.pop_back();
+            return buffer;
+        }
+
+        Buffer buffer;
+        buffer.Data.reset(new uint8_t[size]);
+        buffer.Capacity = size;
+        ResidentBytes += size;
+        return buffer;
+    }
+
+    bool StreamingLumpSource::HasPooledBuffer(size_t size) const
+    {
+        for (const auto& buffer : Pool)
+        {
+            if (buffer.Capacity >= size)
+                return true;
+        }
+
+        return false;
+    }
+
+    void StreamingLumpSource::EvictLeastRecentlyUsed()
+    {
+        auto itr = Cache.find(LeastRecentlyUsed.front());
+        LeastRecentlyUsed.pop_front();
+
+        Pool.push_back(std::move(itr->second.Storage));
+        Cache.erase(itr);
+    }
+
+    void StreamingLumpSource::TrimTo(size_t budget)
+    {
+        while (ResidentBytes > budget && !LeastRecentlyUsed.empty())
+            EvictLeastRecentlyUsed();
+
+        while (ResidentBytes > budget && !Pool.empty())
+        {
+            ResidentBytes -= Pool.back().Capacity;
+            Pool.pop_back();
+        }
+    }
+
+    std::unique_ptr<LumpSource> CreateLumpSource(LumpSourceType type, size_t residentBudget)
+    {
+        switch (type)
+        {
+        case LumpSourceType::Heap:
+            return std::make_unique<HeapLumpSource>();
+        case LumpSourceType::Mapped:
+            return std::make_unique<MappedLumpSource>();
+        case LumpSourceType::Streamed:
+            return std::make_unique<StreamingLumpSource>(residentBudget);
+        }
+
+        return nullptr;
+    }
+
+    LumpData::LumpData(const WADData::DirectoryEntry& entry) : Entry(entry)
+    {
+        Size = entry.LumpSize;
+
+        if (entry.Source)
+            Data = entry.Source->AcquireLump(entry);
+        else if (entry.BufferData)
+            Data = entry.BufferData + entry.LumpOffset;
+
+        if (!Data)
+            Size = 0;
+    }
+
+    LumpData::~LumpData()
+    {
+        if (Data && Entry.Source)
+            Entry.Source->ReleaseLump(Entry);
+    }
+}
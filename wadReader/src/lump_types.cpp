@@ -1,54 +1,29 @@
 #include "lump_types.h"
 
 #include "reader.h"
+#include "lump_source.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace WADData
 {
-    Lump* GetLump(const std::string& name)
+    Lump::Lump() = default;
+    Lump::~Lump() = default;
+
+    Lump* GetLump(WadName name)
     {
-		// map lumps
-        if (name == THINGS)
-            return new ThingsLump();
-        if (name == VERTEXES)
-            return new VertexesLump();
-        if (name == LINEDEFS)
-            return new LineDefLump();
-		if (name == SIDEDEFS)
-			return new SideDefLump();
-		if (name == SECTORS)
-			return new SectorsLump();
-		if (name == SEGS)
-			return new SegsLump();
-		if (name == SSECTORS)
-			return new SubSectorsLump();
-		if (name == NODES)
-			return new NodesLump();
-
-		// map gl lumps
-		if (name == GL_VERT)
-			return new GLVertsLump();
-		if (name == GL_SEGS)
-			return new GLSegsLump();
-        if (name == GL_SSECT)
-            return new GLSubSectorsLump();
-
-		// texture lumps
-		if (name == PLAYPAL)
-			return new PlayPalLump();
-
-		if (name == PNAMES)
-			return new PatchNamesLump();
-		if (name == TEXTURE)
-			return new TexturesLump();
-		if (name == TEXTURE1)
-			return new TexturesLump();
-		if (name == TEXTURE2)
-			return new TexturesLump();
-
-        return nullptr;
+        const LumpType* type = FindLumpType(name);
+        if (!type)
+            return nullptr;
+
+        return type->Create();
     }
 
-    void ThingsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+    void ThingsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
     {
         size_t count = size / Thing::ReadSize;
 
@@ -72,48 +47,26 @@ namespace WADData
         }
     }
 
-    void VertexesLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+    void VertexesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
     {
-        size_t count = size / Vertex::ReadSize;
-
-        Contents.resize(count);
-        for (size_t i = 0; i < count; i++)
-        {
-			size_t readOffset = offset;
-            Contents[i].X = WADReader::ReadInt16(data, readOffset);
-            Contents[i].Y = WADReader::ReadInt16(data, readOffset);
+        Contents = RecordView<Vertex>(data + offset, size);
 
-			Contents[i].Position = { Contents[i].X * MapScale, Contents[i].Y * MapScale };
-
-            offset += Vertex::ReadSize;
-        }
+        Positions.resize(Contents.size());
+        if (!Positions.empty())
+            WADReader::DecodeInt16Pairs(Contents.data(), Positions.size(), Positions.data(), MapScale);
     }
 
-    void LineDefLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+    void LineDefLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
     {
-        size_t count = size / LineDef::ReadSize;
-
-        Contents.resize(count);
-        for (size_t i = 0; i < count; i++)
-        {
-			size_t readOffset = offset;
-
-            Contents[i].Start = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].End = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].Flags = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].SpecialType = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].SectorTag = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].FrontSideDef = WADReader::ReadUInt16(data, readOffset);
-            Contents[i].BackSideDef = WADReader::ReadUInt16(data, readOffset);
-
-            offset += LineDef::ReadSize;
-        }
+        Contents = RecordView<LineDef>(data + offset, size);
     }
 
-	void SideDefLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void SideDefLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		size_t count = size / SideDef::ReadSize;
 
+		NameInterner textures(context.TextureNames);
+
 		Contents.resize(count);
 		for (size_t i = 0; i < count; i++)
 		{
@@ -122,9 +75,9 @@ namespace WADData
             Contents[i].XOffset = WADReader::ReadInt16(data, readOffset);
             Contents[i].YOffset = WADReader::ReadInt16(data, readOffset);
 
-            Contents[i].TopTexture = WADReader::ReadName(data, readOffset);
-			Contents[i].LowerTexture = WADReader::ReadName(data, readOffset);
-            Contents[i].MidTexture = WADReader::ReadName(data, readOffset);
+            Contents[i].TopTexture = textures.Intern(WADReader::ReadName(data, readOffset));
+			Contents[i].LowerTexture = textures.Intern(WADReader::ReadName(data, readOffset));
+            Contents[i].MidTexture = textures.Intern(WADReader::ReadName(data, readOffset));
 
             Contents[i].SectorId = WADReader::ReadInt16(data, readOffset);
 
@@ -134,10 +87,12 @@ namespace WADData
 		}
 	}
 
-	void SectorsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void SectorsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		size_t count = size / Sector::ReadSize;
 
+		NameInterner flats(context.FlatNames);
+
 		Contents.resize(count);
 		for (size_t i = 0; i < count; i++)
 		{
@@ -148,8 +103,8 @@ namespace WADData
 			Contents[i].FloorHeight = WADReader::ReadInt16(data, readOffset);
 			Contents[i].CeilingHeight = WADReader::ReadInt16(data, readOffset);
 
-			Contents[i].FloorTexture = WADReader::ReadName(data, readOffset);
-			Contents[i].CeilingTexture = WADReader::ReadName(data, readOffset);
+			Contents[i].FloorTexture = flats.Intern(WADReader::ReadName(data, readOffset));
+			Contents[i].CeilingTexture = flats.Intern(WADReader::ReadName(data, readOffset));
 
 			Contents[i].LightLevel = WADReader::ReadInt16(data, readOffset);
             Contents[i].SpecialType = WADReader::ReadInt16(data, readOffset);
@@ -162,43 +117,22 @@ namespace WADData
 		}
 	}
 
-	void SegsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void SegsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
-		size_t count = size / Seg::ReadSize;
-
-		Contents.resize(count);
-		for (size_t i = 0; i < count; i++)
-		{
-			memcpy(&Contents[i], data + offset, Seg::ReadSize);
-			offset += Seg::ReadSize;
-		}
+		Contents = RecordView<Seg>(data + offset, size);
 	}
 
-	void SubSectorsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void SubSectorsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
-		size_t count = size / SubSector::ReadSize;
-
-		Contents.resize(count);
-		for (size_t i = 0; i < count; i++)
-		{
-			memcpy(&Contents[i], data + offset, SubSector::ReadSize);
-			offset += SubSector::ReadSize;
-		}
+		Contents = RecordView<SubSector>(data + offset, size);
 	}
 
-	void NodesLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void NodesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
-		size_t count = size / Node::ReadSize;
-
-		Contents.resize(count);
-		for (size_t i = 0; i < count; i++)
-		{
-			memcpy(&Contents[i], data + offset, Node::ReadSize);
-			offset += Node::ReadSize;
-		}
+		Contents = RecordView<Node>(data + offset, size);
 	}
 
-	void GLVertsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion)
+	void GLVertsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		if (size < 4)
 			return;
@@ -224,46 +158,23 @@ namespace WADData
 		size_t count = size / readSize;
 
 		Contents.resize(count);
-		for (size_t i = 0; i < count; i++)
-		{
-			if (wideVerts)
-			{
-				int32_t x;
-				memcpy(&x, data + offset, 4);
-
-				int32_t y;
-				memcpy(&y, data + offset + 4, 4);
-
-				Contents[i].x = x / 65536.0f;
-				Contents[i].y = y / 65536.0f;
-			}
-			else
-			{
-				int16_t x;
-				int16_t y;
-
-				memcpy(&x, data + offset, 2);
-				memcpy(&y, data + offset + 2, 2);
-
-				Contents[i].x = x;
-				Contents[i].y = y;
-			}
-			
-			Contents[i].x *= MapScale;
-			Contents[i].y *= MapScale;
+		if (count == 0)
+			return;
 
-			offset += readSize;
-		}
+		if (wideVerts)
+			WADReader::DecodeFixedPairs(data + offset, count, Contents.data(), MapScale);
+		else
+			WADReader::DecodeInt16Pairs(data + offset, count, Contents.data(), MapScale);
 	}
 
-	void GLSegsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion /*= 0*/)
+	void GLSegsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		std::string magic = "XXXX";
 		memcpy((char*)magic.c_str(), data + offset, 4);
 
 		if (magic == "gNd3")
 			FormatVersion = 3;
-		else if (glVertsVersion == 5)
+		else if (context.GLVertsVersion == 5)
 			FormatVersion = 5;
 
 		size_t readSize = 10;
@@ -333,18 +244,21 @@ namespace WADData
 				seg.PartnerSegIndex = WADReader::ReadUInt16(data, readOffset);
 			}
 
+			if (seg.LineIndex == 0xFFFF)
+				seg.LineIndex = MiniSegLine;
+
 			offset += readSize;
 		}
 	}
 
-    void GLSubSectorsLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion /*= 0*/)
+    void GLSubSectorsLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
     {
         std::string magic = "XXXX";
         memcpy((char*)magic.c_str(), data + offset, 4);
 
         if (magic == "gNd3")
             FormatVersion = 3;
-        else if (glVertsVersion == 5)
+        else if (context.GLVertsVersion == 5)
             FormatVersion = 5;
 
         size_t readSize = 4;
@@ -383,7 +297,224 @@ namespace WADData
 		}
     }
 
-	void PlayPalLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion /*= 0*/)
+    // the 16 bit children flag subsectors with their top bit too, they are moved to the 32 bit flag
+    static uint32_t WidenChild(uint16_t child)
+    {
+        return (child & 0x8000) ? ExtendedNodesLump::SubSectorChild | (child & 0x7FFF) : child;
+    }
+
+    void GLNodesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        bool wideChildren = context.GLVertsVersion == 5;
+        size_t readSize = wideChildren ? 32 : 28;
+
+        Contents.resize(size / readSize);
+
+        for (auto& node : Contents)
+        {
+            const uint8_t* bytes = data + offset;
+
+            node.PartitionStart = Vector2{ LoadInt16LE(bytes) * MapScale, LoadInt16LE(bytes + 2) * MapScale };
+            node.PartitionVector = Vector2{ LoadInt16LE(bytes + 4) * MapScale, LoadInt16LE(bytes + 6) * MapScale };
+
+            for (int i = 0; i < 4; i++)
+            {
+                node.RightBBox[i] = LoadInt16LE(bytes + 8 + i * 2);
+                node.LeftBBox[i] = LoadInt16LE(bytes + 16 + i * 2);
+            }
+
+            if (wideChildren)
+            {
+                node.RightChild = LoadUInt32LE(bytes + 24);
+                node.LeftChild = LoadUInt32LE(bytes + 28);
+            }
+            else
+            {
+                node.RightChild = WidenChild(LoadUInt16LE(bytes + 24));
+                node.LeftChild = WidenChild(LoadUInt16LE(bytes + 26));
+            }
+
+            offset += readSize;
+        }
+    }
+
+    static int CountTrailingZeros(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward64(&index, value);
+        return int(index);
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    void RejectLump::Resize(size_t sectorCount)
+    {
+        SectorCount = sectorCount;
+        RowWords = (sectorCount + 63) / 64;
+        AnyRejects = false;
+
+        // everything starts out visible, the padding past the last sector stays clear
+        Visible.assign(SectorCount * RowWords, ~uint64_t(0));
+        if (sectorCount & 63)
+        {
+            for (size_t row = 0; row < SectorCount; row++)
+                Visible[row * RowWords + RowWords - 1] = (uint64_t(1) << (sectorCount & 63)) - 1;
+        }
+    }
+
+    void RejectLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        Resize(context.SectorCount);
+
+        // a short lump leaves the pairs it doesn't cover visible
+        size_t pairCount = std::min(SectorCount * SectorCount, size * 8);
+        const uint8_t* bytes = data + offset;
+
+        for (size_t byteIndex = 0; byteIndex * 8 < pairCount; byteIndex++)
+        {
+            uint8_t value = bytes[byteIndex];
+            if (value == 0)
+                continue;
+
+            for (int bit = 0; bit < 8; bit++)
+            {
+                size_t pair = byteIndex * 8 + bit;
+                if (pair >= pairCount)
+                    break;
+
+                if (!((value >> bit) & 1))
+                    continue;
+
+                size_t from = pair / SectorCount;
+                size_t to = pair % SectorCount;
+                Visible[to * RowWords + (from >> 6)] &= ~(uint64_t(1) << (from & 63));
+                AnyRejects = true;
+            }
+        }
+    }
+
+    void RejectLump::BuildFromConnectivity(const LineDefLump& lines, const SideDefLump& sides, size_t sectorCount)
+    {
+        Resize(sectorCount);
+
+        // sectors joined by two sided lines, directly or through other sectors, may see each other
+        std::vector<size_t> groups(sectorCount);
+        for (size_t i = 0; i < sectorCount; i++)
+            groups[i] = i;
+
+        auto findGroup = [&](size_t sector)
+        {
+            while (groups[sector] != sector)
+            {
+                groups[sector] = groups[groups[sector]];
+                sector = groups[sector];
+            }
+            return sector;
+        };
+
+        for (size_t i = 0; i < lines.Contents.size(); i++)
+        {
+            const auto line = lines.Contents[i];
+            if (line.FrontSideDef >= sides.Contents.size() || line.BackSideDef >= sides.Contents.size())
+                continue;
+
+            size_t front = sides.Contents[line.FrontSideDef].SectorId;
+            size_t back = sides.Contents[line.BackSideDef].SectorId;
+            if (front >= sectorCount || back >= sectorCount)
+                continue;
+
+            groups[findGroup(front)] = findGroup(back);
+        }
+
+        // one row per group, every sector in the group shares it
+        std::unordered_map<size_t, std::vector<uint64_t>> groupRows;
+        for (size_t sector = 0; sector < sectorCount; sector++)
+        {
+            auto& row = groupRows[findGroup(sector)];
+            row.resize(RowWords, 0);
+            row[sector >> 6] |= uint64_t(1) << (sector & 63);
+        }
+
+        AnyRejects = groupRows.size() > 1;
+
+        for (size_t sector = 0; sector < sectorCount; sector++)
+        {
+            const auto& row = groupRows[findGroup(sector)];
+            std::copy(row.begin(), row.end(), Visible.begin() + sector * RowWords);
+        }
+    }
+
+    void RejectLump::GetSectorsThatSee(size_t sector, std::vector<size_t>& output) const
+    {
+        const uint64_t* row = GetSectorsThatSee(sector);
+        if (!row)
+            return;
+
+        for (size_t word = 0; word < RowWords; word++)
+        {
+            for (uint64_t bits = row[word]; bits != 0; bits &= bits - 1)
+                output.push_back(word * 64 + CountTrailingZeros(bits));
+        }
+    }
+
+    void RejectLump::FilterSectorsThatSee(size_t sector, uint64_t* mask) const
+    {
+        const uint64_t* row = GetSectorsThatSee(sector);
+        if (!row)
+            return;
+
+        // plain word ANDs, the compiler vectorizes this
+        for (size_t word = 0; word < RowWords; word++)
+            mask[word] &= row[word];
+    }
+
+    void GLPVSLump::GetVisibleSubSectors(size_t from, std::vector<size_t>& output) const
+    {
+        const uint64_t* row = GetVisibleSubSectors(from);
+        if (!row)
+            return;
+
+        // the padding bits past the last subsector are cleared when the lump is parsed
+        for (size_t word = 0; word < RowWords; word++)
+        {
+            for (uint64_t bits = row[word]; bits != 0; bits &= bits - 1)
+                output.push_back(word * 64 + CountTrailingZeros(bits));
+        }
+    }
+
+    void GLPVSLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        Visible.clear();
+        SubSectorCount = 0;
+        RowWords = 0;
+
+        // a lump that doesn't cover every subsector was written for other nodes, culling with it would hide the wrong things
+        size_t rowBytes = (context.SubSectorCount + 7) / 8;
+        if (context.SubSectorCount == 0 || size / rowBytes < context.SubSectorCount)
+            return;
+
+        SubSectorCount = context.SubSectorCount;
+        RowWords = (SubSectorCount + 63) / 64;
+        Visible.assign(SubSectorCount * RowWords, 0);
+
+        // bytes are LSB first, the padding bits past the last subsector are dropped
+        uint64_t lastWordMask = (SubSectorCount & 63) ? (uint64_t(1) << (SubSectorCount & 63)) - 1 : ~uint64_t(0);
+
+        for (size_t row = 0; row < SubSectorCount; row++)
+        {
+            const uint8_t* bytes = data + offset + row * rowBytes;
+            uint64_t* words = Visible.data() + row * RowWords;
+
+            for (size_t byteIndex = 0; byteIndex < rowBytes; byteIndex++)
+                words[byteIndex >> 3] |= uint64_t(bytes[byteIndex]) << ((byteIndex & 7) * 8);
+
+            words[RowWords - 1] &= lastWordMask;
+        }
+    }
+
+	void PlayPalLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		size_t count = size / Palette::ReadSize;
 
@@ -403,7 +534,7 @@ namespace WADData
 		}
 	}
 
-	void PatchNamesLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion /*= 0*/)
+	void PatchNamesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		size_t readOffset = offset;
 
@@ -415,7 +546,7 @@ namespace WADData
 		}
 	}
 
-	void TexturesLump::Parse(uint8_t* data, size_t offset, size_t size, int glVertsVersion /*= 0*/)
+	void TexturesLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
 	{
 		size_t readOffset = offset;
 
@@ -448,7 +579,7 @@ namespace WADData
 				texture.Patches.push_back(patch);
 			}
 
-			Contents[texture.Name] = texture;
+			Contents.Insert(texture.Name, texture);
 		}
 	}
 
@@ -0,0 +1,112 @@
+#include "mapped_file.h"
+
+// this file must not include raylib, windows.h collides with it
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WADReader
+{
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+#if defined(_WIN32)
+    bool MappedFile::Open(const char* fileName)
+    {
+        Close();
+
+        HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        FileHandle = file;
+        MappingHandle = mapping;
+        Data = (uint8_t*)view;
+        Size = size_t(fileSize.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (Data)
+            UnmapViewOfFile(Data);
+        if (MappingHandle)
+            CloseHandle((HANDLE)MappingHandle);
+        if (FileHandle)
+            CloseHandle((HANDLE)FileHandle);
+
+        Data = nullptr;
+        Size = 0;
+        MappingHandle = nullptr;
+        FileHandle = nullptr;
+    }
+#else
+    bool MappedFile::Open(const char* fileName)
+    {
+        Close();
+
+        int file = open(fileName, O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(file, &info) != 0 || info.st_size == 0)
+        {
+            close(file);
+            return false;
+        }
+
+        void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+        // the mapping keeps the file referenced, we don't need the descriptor anymore
+        close(file);
+
+        if (view == MAP_FAILED)
+            return false;
+
+        Data = (uint8_t*)view;
+        Size = size_t(info.st_size);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (Data)
+            munmap(Data, Size);
+
+        Data = nullptr;
+        Size = 0;
+    }
+#endif
+}
@@ -0,0 +1,70 @@
+#include "name_table.h"
+
+#include "raylib.h"
+
+namespace WADData
+{
+    static bool IsNoName(WadName name)
+    {
+        return name.IsEmpty() || name == WadName("-");
+    }
+
+    void NameTable::Clear()
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+
+        Names.clear();
+        Ids.clear();
+        Names.push_back(WadName());
+    }
+
+    uint16_t NameTable::Intern(WadName name)
+    {
+        if (IsNoName(name))
+            return None;
+
+        std::lock_guard<std::mutex> lock(Lock);
+
+        uint16_t* existing = Ids.Find(name);
+        if (existing)
+            return *existing;
+
+        if (Names.size() > UINT16_MAX)
+        {
+            TraceLog(LOG_WARNING, "WAD: Too many unique names, %s will not be drawn", name.ToString().c_str());
+            return None;
+        }
+
+        uint16_t id = uint16_t(Names.size());
+        Names.push_back(name);
+        Ids.Insert(name, id);
+        return id;
+    }
+
+    uint16_t NameTable::Find(WadName name) const
+    {
+        if (IsNoName(name))
+            return None;
+
+        std::lock_guard<std::mutex> lock(Lock);
+
+        const uint16_t* id = Ids.Find(name);
+        return id ? *id : None;
+    }
+
+    WadName NameTable::GetName(uint16_t id) const
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+
+        if (id >= Names.size())
+            return WadName();
+
+        return Names[id];
+    }
+
+    size_t NameTable::size() const
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        return Names.size();
+    }
+}
@@ -0,0 +1,564 @@
+#include "node_builder.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace WADData
+{
+    // everything is built in map units, points closer than this are the same point
+    static constexpr double BuildEpsilon = 1.0 / 128.0;
+
+    // how far a seg can be from a leaf edge and still be part of it
+    static constexpr double EdgeEpsilon = BuildEpsilon * 4;
+
+    // the most partition lines scored for one node, bigger seg sets use an even sample of their lines
+    static constexpr size_t MaxPartitionCandidates = 64;
+
+    // segs times candidates below this are scored on the calling thread, thread start up would cost more than it saves
+    static constexpr size_t ParallelScoreWork = 1 << 16;
+
+    static constexpr long SplitCost = 8;
+
+    static constexpr size_t MaxBuildDepth = 1024;
+
+    struct BuildPoint
+    {
+        double X = 0;
+        double Y = 0;
+    };
+
+    struct BuildSeg
+    {
+        BuildPoint Start;
+        BuildPoint End;
+        uint32_t StartVertex = 0;
+        uint32_t EndVertex = 0;
+
+        uint32_t Line = 0;
+        uint8_t Side = 0;
+
+        // the whole linedef in the direction of this seg, partitions use it so pieces of split segs don't drift
+        BuildPoint LineStart;
+        BuildPoint LineDelta;
+    };
+
+    struct BuildPartition
+    {
+        BuildPoint Origin;
+        BuildPoint Delta;
+        double Length = 1;
+
+        BuildPartition() = default;
+        BuildPartition(const BuildPoint& origin, const BuildPoint& delta)
+            : Origin(origin), Delta(delta), Length(std::sqrt(delta.X * delta.X + delta.Y * delta.Y)) {}
+
+        // positive on the front (right) side
+        double Distance(const BuildPoint& point) const
+        {
+            return (Delta.Y * (point.X - Origin.X) - Delta.X * (point.Y - Origin.Y)) / Length;
+        }
+    };
+
+    static double PointDistance(const BuildPoint& a, const BuildPoint& b)
+    {
+        return std::hypot(a.X - b.X, a.Y - b.Y);
+    }
+
+    class NodeBuilder
+    {
+    public:
+        NodeBuilder(const VertexesLump& verts, size_t workerCount) : WorkerCount(workerCount)
+        {
+            OriginalVertexCount = uint32_t(verts.Contents.size());
+
+            Vertices.reserve(OriginalVertexCount);
+            for (size_t i = 0; i < verts.Contents.size(); i++)
+            {
+                const auto vertex = verts.Contents[i];
+                Vertices.push_back(BuildPoint{ double(vertex.X), double(vertex.Y) });
+                VertexLookup.emplace(GetVertexKey(Vertices.back()), uint32_t(i));
+            }
+        }
+
+        bool Build(const LineDefLump& lines, const SideDefLump& sides, ExtendedNodesLump& nodes)
+        {
+            std::vector<BuildSeg> segs;
+            segs.reserve(lines.Contents.size() * 2);
+
+            BuildPoint boundsMin = { 1e9, 1e9 };
+            BuildPoint boundsMax = { -1e9, -1e9 };
+
+            for (size_t lineIndex = 0; lineIndex < lines.Contents.size(); lineIndex++)
+            {
+                const auto line = lines.Contents[lineIndex];
+                if (line.Start >= OriginalVertexCount || line.End >= OriginalVertexCount)
+                    continue;
+
+                const BuildPoint& start = Vertices[line.Start];
+                const BuildPoint& end = Vertices[line.End];
+                if (PointDistance(start, end) < BuildEpsilon)
+                    continue;
+
+                boundsMin = BuildPoint{ std::min({ boundsMin.X, start.X, end.X }), std::min({ boundsMin.Y, start.Y, end.Y }) };
+                boundsMax = BuildPoint{ std::max({ boundsMax.X, start.X, end.X }), std::max({ boundsMax.Y, start.Y, end.Y }) };
+
+                if (line.FrontSideDef != InvalidSideDefIndex && line.FrontSideDef < sides.Contents.size())
+                    segs.push_back(MakeSeg(line.Start, line.End, uint32_t(lineIndex), 0));
+
+                if (line.BackSideDef != InvalidSideDefIndex && line.BackSideDef < sides.Contents.size())
+                    segs.push_back(MakeSeg(line.End, line.Start, uint32_t(lineIndex), 1));
+            }
+
+            if (segs.empty())
+                return false;
+
+            // the root region is the map bounds with some room to spare, clockwise like every subsector
+            constexpr double margin = 64;
+            std::vector<BuildPoint> region =
+            {
+                { boundsMin.X - margin, boundsMin.Y - margin },
+                { boundsMin.X - margin, boundsMax.Y + margin },
+                { boundsMax.X + margin, boundsMax.Y + margin },
+                { boundsMax.X + margin, boundsMin.Y - margin },
+            };
+
+            Subdivide(segs, region, 0);
+
+            // the output uses the XGL3 layout, where a seg ends where the next seg in its subsector starts
+            nodes.Format = ExtendedNodeFormat::XGL3;
+            nodes.Compressed = false;
+            nodes.OriginalVertexCount = OriginalVertexCount;
+
+            nodes.GLVerts.Contents.resize(Vertices.size() - OriginalVertexCount);
+            for (size_t i = OriginalVertexCount; i < Vertices.size(); i++)
+                nodes.GLVerts.Contents[i - OriginalVertexCount] = Vector2{ float(Vertices[i].X * MapScale), float(Vertices[i].Y * MapScale) };
+
+            nodes.GLSegs.Contents = std::move(OutputSegs);
+            nodes.GLSubSectors.Contents = std::move(OutputSubSectors);
+            nodes.Nodes = std::move(OutputNodes);
+
+            return true;
+        }
+
+    protected:
+        size_t WorkerCount = 0;
+
+        uint32_t OriginalVertexCount = 0;
+        std::vector<BuildPoint> Vertices;
+        std::unordered_map<uint64_t, uint32_t> VertexLookup;
+
+        std::vector<GLSegsLump::GLSeg> OutputSegs;
+        std::vector<GLSubSectorsLump::GLSubSector> OutputSubSectors;
+        std::vector<ExtendedNodesLump::Node> OutputNodes;
+
+        static uint64_t GetVertexKey(const BuildPoint& point)
+        {
+            int32_t x = int32_t(std::lround(point.X * 64));
+            int32_t y = int32_t(std::lround(point.Y * 64));
+            return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+        }
+
+        // split points and leaf corners that land on the same spot share a vertex
+        uint32_t AddVertex(const BuildPoint& point)
+        {
+            uint64_t key = GetVertexKey(point);
+
+            auto existing = VertexLookup.find(key);
+            if (existing != VertexLookup.end())
+                return existing->second;
+
+            uint32_t index = uint32_t(Vertices.size());
+            Vertices.push_back(point);
+            VertexLookup.emplace(key, index);
+            return index;
+        }
+
+        BuildSeg MakeSeg(uint32_t start, uint32_t end, uint32_t line, uint8_t side)
+        {
+            BuildSeg seg;
+            seg.Start = Vertices[start];
+            seg.End = Vertices[end];
+            seg.StartVertex = start;
+            seg.EndVertex = end;
+            seg.Line = line;
+            seg.Side = side;
+            seg.LineStart = seg.Start;
+            seg.LineDelta = BuildPoint{ seg.End.X - seg.Start.X, seg.End.Y - seg.Start.Y };
+            return seg;
+        }
+
+        static BuildPartition GetPartition(const BuildSeg& seg)
+        {
+            return BuildPartition(seg.LineStart, seg.LineDelta);
+        }
+
+        enum class SegSide
+        {
+            Front,
+            Back,
+            Split,
+        };
+
+        static SegSide Classify(const BuildSeg& seg, const BuildPartition& partition, double& startDistance, double& endDistance)
+        {
+            startDistance = partition.Distance(seg.Start);
+            endDistance = partition.Distance(seg.End);
+
+            // segs on the partition go with the side they face
+            if (std::abs(startDistance) < BuildEpsilon && std::abs(endDistance) < BuildEpsilon)
+            {
+                double dot = (seg.End.X - seg.Start.X) * partition.Delta.X + (seg.End.Y - seg.Start.Y) * partition.Delta.Y;
+                return dot > 0 ? SegSide::Front : SegSide::Back;
+            }
+
+            if (startDistance > -BuildEpsilon && endDistance > -BuildEpsilon)
+                return SegSide::Front;
+
+            if (startDistance < BuildEpsilon && endDistance < BuildEpsilon)
+                return SegSide::Back;
+
+            return SegSide::Split;
+        }
+
+        // lower is better, false when the partition leaves one side empty
+        static bool ScorePartition(const std::vector<BuildSeg>& segs, const BuildPartition& partition, long& score)
+        {
+            long front = 0;
+            long back = 0;
+            long splits = 0;
+
+            for (const auto& seg : segs)
+            {
+                double startDistance, endDistance;
+                switch (Classify(seg, partition, startDistance, endDistance))
+                {
+                case SegSide::Front:
+                    front++;
+                    break;
+                case SegSide::Back:
+                    back++;
+                    break;
+                case SegSide::Split:
+                    splits++;
+                    break;
+                }
+            }
+
+            if (back + splits == 0 || front + splits == 0)
+                return false;
+
+            score = splits * SplitCost + std::abs(front - back);
+            return true;
+        }
+
+        // the best partition among the given segs' lines, false when every one of them leaves a side empty
+        bool ChoosePartition(const std::vector<BuildSeg>& segs, const std::vector<size_t>& candidates, size_t& best)
+        {
+            std::vector<long> scores(candidates.size(), 0);
+            std::vector<uint8_t> valid(candidates.size(), 0);
+
+            auto score = [&](size_t i)
+            {
+                valid[i] = ScorePartition(segs, GetPartition(segs[candidates[i]]), scores[i]) ? 1 : 0;
+            };
+
+            if (segs.size() * candidates.size() >= ParallelScoreWork)
+            {
+                WADReader::ParallelFor(candidates.size(), score, WorkerCount);
+            }
+            else
+            {
+                for (size_t i = 0; i < candidates.size(); i++)
+                    score(i);
+            }
+
+            bool found = false;
+            long bestScore = 0;
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                if (!valid[i] || (found && scores[i] >= bestScore))
+                    continue;
+
+                found = true;
+                bestScore = scores[i];
+                best = candidates[i];
+            }
+
+            return found;
+        }
+
+        // one candidate per linedef side, sampled evenly when there are too many
+        static std::vector<size_t> GetCandidates(const std::vector<BuildSeg>& segs, size_t limit)
+        {
+            std::vector<size_t> unique;
+            std::unordered_set<uint64_t> seen;
+
+            for (size_t i = 0; i < segs.size(); i++)
+            {
+                if (seen.insert((uint64_t(segs[i].Line) << 1) | segs[i].Side).second)
+                    unique.push_back(i);
+            }
+
+            if (unique.size() <= limit)
+                return unique;
+
+            std::vector<size_t> candidates;
+            candidates.reserve(limit);
+            for (size_t i = 0; i < limit; i++)
+                candidates.push_back(unique[i * unique.size() / limit]);
+
+            return candidates;
+        }
+
+        void SplitSegs(const std::vector<BuildSeg>& segs, const BuildPartition& partition, std::vector<BuildSeg>& front, std::vector<BuildSeg>& back)
+        {
+            for (const auto& seg : segs)
+            {
+                double startDistance, endDistance;
+                switch (Classify(seg, partition, startDistance, endDistance))
+                {
+                case SegSide::Front:
+                    front.push_back(seg);
+                    break;
+                case SegSide::Back:
+                    back.push_back(seg);
+                    break;
+                case SegSide::Split:
+                {
+                    double t = startDistance / (startDistance - endDistance);
+                    BuildPoint point = { seg.Start.X + (seg.End.X - seg.Start.X) * t, seg.Start.Y + (seg.End.Y - seg.Start.Y) * t };
+                    uint32_t vertex = AddVertex(point);
+
+                    BuildSeg first = seg;
+                    first.End = point;
+                    first.EndVertex = vertex;
+
+                    BuildSeg second = seg;
+                    second.Start = point;
+                    second.StartVertex = vertex;
+
+                    if (startDistance > 0)
+                    {
+                        front.push_back(first);
+                        back.push_back(second);
+                    }
+                    else
+                    {
+                        back.push_back(first);
+                        front.push_back(second);
+                    }
+                    break;
+                }
+                }
+            }
+        }
+
+        // keeps the part of a convex polygon on one side of a partition
+        static std::vector<BuildPoint> ClipRegion(const std::vector<BuildPoint>& region, const BuildPartition& partition, bool keepFront)
+        {
+            std::vector<BuildPoint> clipped;
+            clipped.reserve(region.size() + 1);
+
+            double sign = keepFront ? 1.0 : -1.0;
+
+            for (size_t i = 0; i < region.size(); i++)
+            {
+                const BuildPoint& current = region[i];
+                const BuildPoint& next = region[(i + 1) % region.size()];
+
+                double currentDistance = partition.Distance(current) * sign;
+                double nextDistance = partition.Distance(next) * sign;
+
+                if (currentDistance >= 0)
+                    clipped.push_back(current);
+
+                if ((currentDistance >= 0) != (nextDistance >= 0))
+                {
+                    double t = currentDistance / (currentDistance - nextDistance);
+                    clipped.push_back(BuildPoint{ current.X + (next.X - current.X) * t, current.Y + (next.Y - current.Y) * t });
+                }
+            }
+
+            return clipped;
+        }
+
+        static void GetBounds(const std::vector<BuildSeg>& segs, int16_t bounds[4])
+        {
+            double top = -1e9, bottom = 1e9, left = 1e9, right = -1e9;
+            for (const auto& seg : segs)
+            {
+                top = std::max({ top, seg.Start.Y, seg.End.Y });
+                bottom = std::min({ bottom, seg.Start.Y, seg.End.Y });
+                left = std::min({ left, seg.Start.X, seg.End.X });
+                right = std::max({ right, seg.Start.X, seg.End.X });
+            }
+
+            auto clamp = [](double value) { return int16_t(std::clamp(value, -32768.0, 32767.0)); };
+
+            bounds[0] = clamp(std::ceil(top));
+            bounds[1] = clamp(std::floor(bottom));
+            bounds[2] = clamp(std::floor(left));
+            bounds[3] = clamp(std::ceil(right));
+        }
+
+        // returns the child reference for the node or subsector made from the segs
+        uint32_t Subdivide(std::vector<BuildSeg>& segs, const std::vector<BuildPoint>& region, size_t depth)
+        {
+            size_t best = 0;
+            bool found = false;
+
+            if (depth < MaxBuildDepth)
+            {
+                auto candidates = GetCandidates(segs, MaxPartitionCandidates);
+                found = ChoosePartition(segs, candidates, best);
+
+                // a sample that found nothing doesn't prove the set is convex, so every line gets a look before giving up
+                if (!found && candidates.size() == MaxPartitionCandidates)
+                    found = ChoosePartition(segs, GetCandidates(segs, segs.size()), best);
+            }
+
+            if (!found)
+                return MakeSubSector(segs, region) | ExtendedNodesLump::SubSectorChild;
+
+            BuildPartition partition = GetPartition(segs[best]);
+
+            std::vector<BuildSeg> front, back;
+            SplitSegs(segs, partition, front, back);
+
+            segs.clear();
+            segs.shrink_to_fit();
+
+            ExtendedNodesLump::Node node;
+            node.PartitionStart = Vector2{ float(partition.Origin.X * MapScale), float(partition.Origin.Y * MapScale) };
+            node.PartitionVector = Vector2{ float(partition.Delta.X * MapScale), float(partition.Delta.Y * MapScale) };
+            GetBounds(front, node.RightBBox);
+            GetBounds(back, node.LeftBBox);
+
+            node.RightChild = Subdivide(front, ClipRegion(region, partition, true), depth + 1);
+            node.LeftChild = Subdivide(back, ClipRegion(region, partition, false), depth + 1);
+
+            // children come first, so the root ends up as the last node like every other node builder
+            OutputNodes.push_back(node);
+            return uint32_t(OutputNodes.size() - 1);
+        }
+
+        void AddOutputSeg(uint32_t start, size_t line, uint8_t side)
+        {
+            GLSegsLump::GLSeg seg;
+            seg.StartIsGL = start >= OriginalVertexCount;
+            seg.Start = seg.StartIsGL ? start - OriginalVertexCount : start;
+            seg.LineIndex = line;
+            seg.Direction = side;
+            seg.PartnerSegIndex = size_t(-1);
+            OutputSegs.push_back(seg);
+        }
+
+        uint32_t MakeSubSector(const std::vector<BuildSeg>& segs, const std::vector<BuildPoint>& region)
+        {
+            // the leaf is what is left of its region in front of all of its segs
+            std::vector<BuildPoint> polygon = region;
+            for (const auto& seg : segs)
+            {
+                if (polygon.size() < 3)
+                    break;
+                polygon = ClipRegion(polygon, GetPartition(seg), true);
+            }
+
+            GLSubSectorsLump::GLSubSector subSector;
+            subSector.StartSegment = OutputSegs.size();
+
+            std::vector<uint8_t> used(segs.size(), 0);
+            bool hasLineSeg = false;
+
+            if (polygon.size() >= 3)
+            {
+                // walk the polygon, each edge is made of the segs that lie on it with minisegs across the gaps
+                uint32_t current = AddVertex(polygon[0]);
+                BuildPoint currentPoint = polygon[0];
+
+                std::vector<size_t> onEdge;
+                for (size_t edgeIndex = 0; edgeIndex < polygon.size(); edgeIndex++)
+                {
+                    const BuildPoint& edgeStart = polygon[edgeIndex];
+                    const BuildPoint& edgeEnd = polygon[(edgeIndex + 1) % polygon.size()];
+
+                    BuildPoint delta = { edgeEnd.X - edgeStart.X, edgeEnd.Y - edgeStart.Y };
+                    if (std::hypot(delta.X, delta.Y) < BuildEpsilon)
+                        continue;
+
+                    BuildPartition edge(edgeStart, delta);
+
+                    onEdge.clear();
+                    for (size_t i = 0; i < segs.size(); i++)
+                    {
+                        const auto& seg = segs[i];
+                        if (used[i] || std::abs(edge.Distance(seg.Start)) > EdgeEpsilon || std::abs(edge.Distance(seg.End)) > EdgeEpsilon)
+                            continue;
+
+                        if ((seg.End.X - seg.Start.X) * delta.X + (seg.End.Y - seg.Start.Y) * delta.Y <= 0)
+                            continue;
+
+                        onEdge.push_back(i);
+                    }
+
+                    auto along = [&](const BuildPoint& point) { return (point.X - edgeStart.X) * delta.X + (point.Y - edgeStart.Y) * delta.Y; };
+                    std::sort(onEdge.begin(), onEdge.end(), [&](size_t a, size_t b) { return along(segs[a].Start) < along(segs[b].Start); });
+
+                    for (size_t i : onEdge)
+                    {
+                        const auto& seg = segs[i];
+                        used[i] = 1;
+
+                        if (PointDistance(currentPoint, seg.Start) > EdgeEpsilon)
+                            AddOutputSeg(current, GLSegsLump::MiniSegLine, 0);
+
+                        AddOutputSeg(seg.StartVertex, seg.Line, seg.Side);
+                        hasLineSeg = true;
+
+                        current = seg.EndVertex;
+                        currentPoint = seg.End;
+                    }
+
+                    if (PointDistance(currentPoint, edgeEnd) > EdgeEpsilon)
+                    {
+                        AddOutputSeg(current, GLSegsLump::MiniSegLine, 0);
+                        current = AddVertex(edgeEnd);
+                        currentPoint = edgeEnd;
+                    }
+                }
+            }
+
+            // a leaf too thin to carve keeps its segs as they are, so it still has a sector
+            if (!hasLineSeg)
+            {
+                OutputSegs.resize(subSector.StartSegment);
+                for (const auto& seg : segs)
+                    AddOutputSeg(seg.StartVertex, seg.Line, seg.Side);
+            }
+
+            subSector.Count = OutputSegs.size() - subSector.StartSegment;
+
+            // a seg ends where the next one in the loop starts
+            for (size_t i = 0; i < subSector.Count; i++)
+            {
+                auto& seg = OutputSegs[subSector.StartSegment + i];
+                const auto& next = OutputSegs[subSector.StartSegment + (i + 1) % subSector.Count];
+                seg.End = next.Start;
+                seg.EndIsGL = next.StartIsGL;
+            }
+
+            OutputSubSectors.push_back(subSector);
+            return uint32_t(OutputSubSectors.size() - 1);
+        }
+    };
+
+    bool BuildGLNodes(const VertexesLump& verts, const LineDefLump& lines, const SideDefLump& sides, ExtendedNodesLump& nodes, size_t workerCount)
+    {
+        NodeBuilder builder(verts, workerCount);
+        return builder.Build(lines, sides, nodes);
+    }
+}
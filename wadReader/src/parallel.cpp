@@ -0,0 +1,46 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace WADReader
+{
+    size_t GetDefaultWorkerCount()
+    {
+        size_t cores = std::thread::hardware_concurrency();
+        return cores > 0 ? cores : 1;
+    }
+
+    void ParallelFor(size_t count, const std::function<void(size_t index)>& work, size_t workerCount)
+    {
+        if (workerCount == 0)
+            workerCount = GetDefaultWorkerCount();
+        if (workerCount > count)
+            workerCount = count;
+
+        if (workerCount <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                work(i);
+            return;
+        }
+
+        std::atomic<size_t> next = 0;
+        auto worker = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+                work(i);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workerCount - 1);
+        for (size_t i = 1; i < workerCount; i++)
+            threads.emplace_back(worker);
+
+        worker();
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+}
@@ -0,0 +1,162 @@
+#include "quad_tree.h"
+
+namespace WADData
+{
+    void QuadTree::Clear()
+    {
+        Nodes.clear();
+        Items.clear();
+        Slots.clear();
+        ItemNodes.clear();
+    }
+
+    void QuadTree::Build(Span<const Bounds> bounds)
+    {
+        Clear();
+
+        Slots.assign(bounds.size(), uint32_t(-1));
+
+        Bounds world;
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            if (bounds[i].IsEmpty() || !std::isfinite(bounds[i].MinX + bounds[i].MinY + bounds[i].MaxX + bounds[i].MaxY))
+                continue;
+
+            Items.push_back(Item{ bounds[i], uint32_t(i) });
+            world.Add(bounds[i]);
+        }
+
+        if (Items.empty())
+            return;
+
+        // the root cell is the square around everything, its children are made as they are needed
+        float cellSize = std::max(std::max(world.MaxX - world.MinX, world.MaxY - world.MinY), 1e-3f);
+
+        Nodes.reserve(Items.size() / LeafSize * 2 + 1);
+        Nodes.emplace_back();
+        BuildNode(0, 0, uint32_t(Items.size()), world.MinX, world.MinY, cellSize, 0);
+
+        ItemNodes.resize(Items.size());
+        for (uint32_t nodeIndex = 0; nodeIndex < Nodes.size(); nodeIndex++)
+        {
+            const Node& node = Nodes[nodeIndex];
+            for (uint32_t slot = node.FirstItem; slot < node.FirstItem + node.ItemCount; slot++)
+                ItemNodes[slot] = nodeIndex;
+        }
+
+        for (uint32_t slot = 0; slot < Items.size(); slot++)
+            Slots[Items[slot].Index] = slot;
+    }
+
+    void QuadTree::BuildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, float cellX, float cellY, float cellSize, int depth)
+    {
+        Bounds box;
+        for (uint32_t slot = begin; slot < end; slot++)
+            box.Add(Items[slot].Box);
+
+        Nodes[nodeIndex].Box = box;
+        Nodes[nodeIndex].FirstItem = begin;
+        Nodes[nodeIndex].ItemCount = end - begin;
+        Nodes[nodeIndex].SubtreeEnd = end;
+
+        if (end - begin <= LeafSize || depth >= MaxDepth)
+            return;
+
+        // items bigger than a child's cell stay here, the loose child bounds are twice the cell so anything smaller fits in one
+        float half = cellSize * 0.5f;
+        float splitX = cellX + half;
+        float splitY = cellY + half;
+
+        auto first = Items.begin();
+        auto stays = std::partition(first + begin, first + end, [&](const Item& item)
+        {
+            return item.Box.MaxX - item.Box.MinX > half || item.Box.MaxY - item.Box.MinY > half;
+        });
+
+        // the rest are sorted into the quadrants their centres are in, left then right and bottom then top
+        auto left = std::partition(stays, first + end, [&](const Item& item) { return item.Box.MinX + item.Box.MaxX < splitX * 2; });
+        auto bottomLeft = std::partition(stays, left, [&](const Item& item) { return item.Box.MinY + item.Box.MaxY < splitY * 2; });
+        auto bottomRight = std::partition(left, first + end, [&](const Item& item) { return item.Box.MinY + item.Box.MaxY < splitY * 2; });
+
+        uint32_t edges[5] = { uint32_t(stays - first), uint32_t(bottomLeft - first), uint32_t(left - first), uint32_t(bottomRight - first), end };
+        float cornerX[4] = { cellX, cellX, splitX, splitX };
+        float cornerY[4] = { cellY, splitY, cellY, splitY };
+
+        Nodes[nodeIndex].ItemCount = edges[0] - begin;
+
+        // every item staying here would only add a level that holds nothing
+        if (edges[0] == end)
+            return;
+
+        uint32_t firstChild = uint32_t(Nodes.size());
+        uint32_t childCount = 0;
+        for (int quadrant = 0; quadrant < 4; quadrant++)
+        {
+            if (edges[quadrant] != edges[quadrant + 1])
+                childCount++;
+        }
+
+        Nodes.resize(Nodes.size() + childCount);
+        Nodes[nodeIndex].FirstChild = firstChild;
+        Nodes[nodeIndex].ChildCount = childCount;
+
+        uint32_t child = firstChild;
+        for (int quadrant = 0; quadrant < 4; quadrant++)
+        {
+            if (edges[quadrant] == edges[quadrant + 1])
+                continue;
+
+            Nodes[child].Parent = nodeIndex;
+            BuildNode(child, edges[quadrant], edges[quadrant + 1], cornerX[quadrant], cornerY[quadrant], half, depth + 1);
+            child++;
+        }
+    }
+
+    void QuadTree::Update(uint32_t index, const Bounds& bounds)
+    {
+        if (index >= Slots.size() || Slots[index] == uint32_t(-1) || bounds.IsEmpty())
+            return;
+
+        uint32_t slot = Slots[index];
+        Items[slot].Box = bounds;
+
+        for (uint32_t nodeIndex = ItemNodes[slot]; nodeIndex != uint32_t(-1); nodeIndex = Nodes[nodeIndex].Parent)
+        {
+            if (Nodes[nodeIndex].Box.Contains(bounds))
+                break;
+
+            Nodes[nodeIndex].Box.Add(bounds);
+        }
+    }
+
+    size_t QuadTree::FindInBox(const Bounds& box, Span<uint32_t> out) const
+    {
+        size_t found = 0;
+        ForEachInBox(box, [&](uint32_t index)
+        {
+            if (found < out.size())
+                out[found] = index;
+            found++;
+            return true;
+        });
+        return found;
+    }
+
+    size_t QuadTree::FindInCircle(float x, float y, float radius, Span<uint32_t> out) const
+    {
+        size_t found = 0;
+        ForEachInCircle(x, y, radius, [&](uint32_t index)
+        {
+            if (found < out.size())
+                out[found] = index;
+            found++;
+            return true;
+        });
+        return found;
+    }
+
+    size_t QuadTree::FindNearest(float x, float y, float maxDistance, Span<Neighbour> out) const
+    {
+        return FindNearest(x, y, maxDistance, out, [&](uint32_t index) { return Items[Slots[index]].Box.DistanceSquared(x, y); });
+    }
+}
@@ -0,0 +1,134 @@
+#include "random_access_file.h"
+
+// this file must not include raylib, windows.h collides with it
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WADReader
+{
+    RandomAccessFile::~RandomAccessFile()
+    {
+        Close();
+    }
+
+#if defined(_WIN32)
+    bool RandomAccessFile::Open(const char* fileName)
+    {
+        Close();
+
+        HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        FileHandle = file;
+        Size = size_t(fileSize.QuadPart);
+        return true;
+    }
+
+    void RandomAccessFile::Close()
+    {
+        if (FileHandle)
+            CloseHandle((HANDLE)FileHandle);
+
+        FileHandle = nullptr;
+        Size = 0;
+    }
+
+    bool RandomAccessFile::IsOpen() const
+    {
+        return FileHandle != nullptr;
+    }
+
+    bool RandomAccessFile::Read(size_t offset, size_t size, uint8_t* destination) const
+    {
+        if (!FileHandle || offset + size > Size)
+            return false;
+
+        while (size > 0)
+        {
+            DWORD chunk = size > 0x40000000 ? 0x40000000 : DWORD(size);
+
+            OVERLAPPED position = { 0 };
+            position.Offset = DWORD(uint64_t(offset) & 0xFFFFFFFF);
+            position.OffsetHigh = DWORD(uint64_t(offset) >> 32);
+
+            DWORD readSize = 0;
+            if (!ReadFile((HANDLE)FileHandle, destination, chunk, &readSize, &position) || readSize == 0)
+                return false;
+
+            offset += readSize;
+            destination += readSize;
+            size -= readSize;
+        }
+
+        return true;
+    }
+#else
+    bool RandomAccessFile::Open(const char* fileName)
+    {
+        Close();
+
+        int file = open(fileName, O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(file, &info) != 0)
+        {
+            close(file);
+            return false;
+        }
+
+        FileDescriptor = file;
+        Size = size_t(info.st_size);
+        return true;
+    }
+
+    void RandomAccessFile::Close()
+    {
+        if (FileDescriptor >= 0)
+            close(FileDescriptor);
+
+        FileDescriptor = -1;
+        Size = 0;
+    }
+
+    bool RandomAccessFile::IsOpen() const
+    {
+        return FileDescriptor >= 0;
+    }
+
+    bool RandomAccessFile::Read(size_t offset, size_t size, uint8_t* destination) const
+    {
+        if (FileDescriptor < 0 || offset + size > Size)
+            return false;
+
+        while (size > 0)
+        {
+            ssize_t readSize = pread(FileDescriptor, destination, size, off_t(offset));
+            if (readSize <= 0)
+                return false;
+
+            offset += size_t(readSize);
+            destination += readSize;
+            size -= size_t(readSize);
+        }
+
+        return true;
+    }
+#endif
+}
@@ -0,0 +1,277 @@
+#include "doom_map.h"
+
+#include "parallel.h"
+#include "raymath.h"
+
+#include <algorithm>
+#include <cmath>
+
+// a linedef a ray crosses, T is the distance along the ray
+struct RayIntercept
+{
+    float T = 0;
+    uint32_t Line = 0;
+
+    // true when the ray goes from the line's front side to its back
+    bool FrontToBack = false;
+};
+
+// each thread has its own, so rays can be cast from any thread and nothing is allocated once it has grown
+static thread_local std::vector<RayIntercept> Intercepts;
+
+// where origin + delta * t crosses the segment from start to end, false when it misses or runs alongside it
+static bool CrossSegment(Vector2 origin, Vector2 delta, Vector2 start, Vector2 end, float& t, bool& frontToBack)
+{
+    Vector2 line = Vector2Subtract(end, start);
+    float denominator = delta.x * line.y - delta.y * line.x;
+    if (denominator == 0)
+        return false;
+
+    Vector2 toStart = Vector2Subtract(start, origin);
+    float u = (toStart.x * delta.y - toStart.y * delta.x) / denominator;
+    if (!(u >= 0 && u <= 1))
+        return false;
+
+    t = (toStart.x * line.y - toStart.y * line.x) / denominator;
+
+    // the front side is on the right of the line, a ray heading to its left goes from front to back
+    frontToBack = denominator < 0;
+    return true;
+}
+
+// trims the run of t where origin + delta * t is inside the box, false when it never is
+static bool ClipToBounds(Vector2 origin, Vector2 delta, const WADData::QuadTree::Bounds& bounds, float& tStart, float& tEnd)
+{
+    float starts[2] = { origin.x, origin.y };
+    float deltas[2] = { delta.x, delta.y };
+    float mins[2] = { bounds.MinX, bounds.MinY };
+    float maxs[2] = { bounds.MaxX, bounds.MaxY };
+
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (deltas[axis] == 0)
+        {
+            if (starts[axis] < mins[axis] || starts[axis] > maxs[axis])
+                return false;
+            continue;
+        }
+
+        float enter = (mins[axis] - starts[axis]) / deltas[axis];
+        float leave = (maxs[axis] - starts[axis]) / deltas[axis];
+        if (enter > leave)
+            std::swap(enter, leave);
+
+        tStart = std::max(tStart, enter);
+        tEnd = std::min(tEnd, leave);
+    }
+
+    return tStart <= tEnd;
+}
+
+// the sectors on the front and back of a linedef, size_t(-1) for a side it doesn't have
+static void GetLineSectors(const WADFile::LevelMap& map, const WADData::LineDefLump::LineDef& line, size_t& front, size_t& back)
+{
+    auto sectorOf = [&](uint16_t side)
+    {
+        if (side == WADData::InvalidSideDefIndex || side >= map.Sides->Contents.size())
+            return size_t(-1);
+
+        size_t sector = map.Sides->Contents[side].SectorId;
+        return sector < map.Sectors->Contents.size() ? sector : size_t(-1);
+    };
+
+    front = sectorOf(line.FrontSideDef);
+    back = sectorOf(line.BackSideDef);
+}
+
+// true when something at height z fits through the gap between two sectors
+static bool FitsOpening(const WADFile::LevelMap& map, size_t front, size_t back, float z)
+{
+    if (front == size_t(-1) || back == size_t(-1))
+        return false;
+
+    const auto& frontSector = map.Sectors->Contents[front];
+    const auto& backSector = map.Sectors->Contents[back];
+
+    return z >= std::max(frontSector.Floor, backSector.Floor) && z <= std::min(frontSector.Ceiling, backSector.Ceiling);
+}
+
+WADFile::LevelMap::RayHit WADFile::LevelMap::RayCast(Vector3 origin, Vector3 direction, float maxDistance) const
+{
+    RayHit hit;
+    hit.Position = origin;
+
+    float length = Vector3Length(direction);
+    if (!(length > 0) || !(maxDistance >= 0) || !Lines || !Sides || !Sectors)
+        return hit;
+
+    Vector3 unit = Vector3Scale(direction, 1.0f / length);
+    Vector2 start = { origin.x, origin.y };
+    Vector2 ground = { unit.x, unit.y };
+
+    auto stop = [&](RayHit::HitType type, float distance, size_t sector, size_t line)
+    {
+        hit.Type = type;
+        hit.Distance = distance;
+        hit.Sector = sector;
+        hit.Line = line;
+        hit.Position = Vector3Add(origin, Vector3Scale(unit, distance));
+        return hit;
+    };
+
+    // nothing past the edge of the map can be hit, so the walk is never longer than the map is wide
+    float tStart = 0;
+    float tEnd = maxDistance;
+    bool onMap = LineTree.IsBuilt() && ClipToBounds(start, ground, LineTree.GetBounds(), tStart, tEnd);
+    if (!onMap)
+        tEnd = maxDistance;
+
+    auto& intercepts = Intercepts;
+    intercepts.clear();
+
+    if (onMap && (ground.x != 0 || ground.y != 0))
+    {
+        Vector2 walkStart = Vector2Add(start, Vector2Scale(ground, tStart));
+        Vector2 walkEnd = Vector2Add(start, Vector2Scale(ground, tEnd));
+
+        ForEachLineAlongSegment(walkStart, walkEnd, [&](size_t lineIndex)
+        {
+            const auto line = Lines->Contents[lineIndex];
+            if (line.Start >= Vertices.size() || line.End >= Vertices.size())
+                return true;
+
+            RayIntercept intercept;
+            intercept.Line = uint32_t(lineIndex);
+            if (CrossSegment(start, ground, Vertices.Get(line.Start), Vertices.Get(line.End), intercept.T, intercept.FrontToBack) && intercept.T >= 0 && intercept.T <= tEnd)
+                intercepts.push_back(intercept);
+            return true;
+        });
+
+        // the blockmap hands lines over block by block, not in the order the ray crosses them
+        std::sort(intercepts.begin(), intercepts.end(), [](const RayIntercept& a, const RayIntercept& b) { return a.T < b.T; });
+    }
+
+    // the ray is in one sector between crossings, it can only leave it through the floor or ceiling before the next one
+    size_t sector = GetSectorFromPoint(origin.x, origin.y);
+    float from = 0;
+
+    auto hitsPlane = [&](float to)
+    {
+        if (sector >= Sectors->Contents.size())
+            return false;
+
+        const auto& rawSector = Sectors->Contents[sector];
+
+        float z = origin.z + unit.z * from;
+        if (z < rawSector.Floor || z > rawSector.Ceiling)
+        {
+            stop(z < rawSector.Floor ? RayHit::HitType::Floor : RayHit::HitType::Ceiling, from, sector, size_t(-1));
+            return true;
+        }
+
+        if (unit.z < 0)
+        {
+            float t = (rawSector.Floor - origin.z) / unit.z;
+            if (t <= to)
+            {
+                stop(RayHit::HitType::Floor, std::max(t, from), sector, size_t(-1));
+                return true;
+            }
+        }
+        else if (unit.z > 0)
+        {
+            float t = (rawSector.Ceiling - origin.z) / unit.z;
+            if (t <= to)
+            {
+                stop(RayHit::HitType::Ceiling, std::max(t, from), sector, size_t(-1));
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    for (const auto& intercept : intercepts)
+    {
+        if (hitsPlane(intercept.T))
+            return hit;
+
+        size_t front = size_t(-1);
+        size_t back = size_t(-1);
+        GetLineSectors(*this, Lines->Contents[intercept.Line], front, back);
+
+        size_t leaving = intercept.FrontToBack ? front : back;
+        size_t entering = intercept.FrontToBack ? back : front;
+
+        // one sided lines block from either side, two sided ones block above and below the gap between their sectors
+        if (!FitsOpening(*this, front, back, origin.z + unit.z * intercept.T))
+            return stop(RayHit::HitType::Wall, intercept.T, leaving != size_t(-1) ? leaving : sector, intercept.Line);
+
+        sector = entering;
+        from = intercept.T;
+    }
+
+    if (hitsPlane(tEnd))
+        return hit;
+
+    if (std::isfinite(tEnd))
+    {
+        stop(RayHit::HitType::None, tEnd, sector, size_t(-1));
+    }
+    else
+    {
+        hit.Distance = tEnd;
+        hit.Sector = sector;
+    }
+    return hit;
+}
+
+void WADFile::LevelMap::RayCasts(WADData::Span<const Ray> rays, WADData::Span<RayHit> outHits, float maxDistance, size_t workerCount) const
+{
+    size_t count = std::min(rays.size(), outHits.size());
+
+    // rays are handed out in runs, so a thread's intercepts and blockmap stamps are reused for a while
+    constexpr size_t runSize = 64;
+    size_t runs = (count + runSize - 1) / runSize;
+
+    WADReader::ParallelFor(runs, [&](size_t run)
+    {
+        size_t end = std::min(count, (run + 1) * runSize);
+        for (size_t i = run * runSize; i < end; i++)
+            outHits[i] = RayCast(rays[i].position, rays[i].direction, maxDistance);
+    }, workerCount);
+}
+
+bool WADFile::LevelMap::HasLineOfSight(Vector3 from, Vector3 to) const
+{
+    size_t fromSector = GetSectorFromPoint(from.x, from.y);
+    size_t toSector = GetSectorFromPoint(to.x, to.y);
+    if (fromSector != size_t(-1) && toSector != size_t(-1) && !CanSectorsSee(fromSector, toSector))
+        return false;
+
+    if (!Lines || !Sides || !Sectors)
+        return true;
+
+    // a straight line that is inside a sector's heights where it enters and leaves it stays inside them in between,
+    // so only the gaps it goes through matter and the lines can be checked in any order
+    Vector2 start = { from.x, from.y };
+    Vector2 delta = { to.x - from.x, to.y - from.y };
+
+    return ForEachLineAlongSegment(start, Vector2{ to.x, to.y }, [&](size_t lineIndex)
+    {
+        const auto line = Lines->Contents[lineIndex];
+        if (line.Start >= Vertices.size() || line.End >= Vertices.size())
+            return true;
+
+        float t = 0;
+        bool frontToBack = false;
+        if (!CrossSegment(start, delta, Vertices.Get(line.Start), Vertices.Get(line.End), t, frontToBack) || t < 0 || t > 1)
+            return true;
+
+        size_t front = size_t(-1);
+        size_t back = size_t(-1);
+        GetLineSectors(*this, line, front, back);
+
+        return FitsOpening(*this, front, back, from.z + (to.z - from.z) * t);
+    });
+}
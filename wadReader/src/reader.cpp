@@ -1,31 +1,47 @@
 #include "reader.h"
+#include "lump_source.h"
+
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // the vector paths load the lump bytes as they are, so big endian hosts use the scalar loops
+#elif defined(__AVX2__)
+#define WAD_READER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAD_READER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define WAD_READER_NEON
+#include <arm_neon.h>
+#endif
 
 namespace WADReader
 {
     int32_t ReadInt(uint8_t* buffer, size_t& offset)
     {
-        int32_t value = *(int32_t*)(buffer + offset);
+        int32_t value = WADData::LoadInt32LE(buffer + offset);
         offset += 4;
         return value;
     }
 
 	uint32_t ReadUInt(uint8_t* buffer, size_t& offset)
 	{
-        uint32_t value = *(uint32_t*)(buffer + offset);
+        uint32_t value = WADData::LoadUInt32LE(buffer + offset);
 		offset += 4;
 		return value;
 	}
 
 	int16_t ReadInt16(uint8_t* buffer, size_t& offset)
 	{
-        int16_t value = *(int16_t*)(buffer + offset);
+        int16_t value = WADData::LoadInt16LE(buffer + offset);
 		offset += 2;
 		return value;
 	}
 
 	uint16_t ReadUInt16(uint8_t* buffer, size_t& offset)
 	{
-        uint16_t value = *(uint16_t*)(buffer + offset);
+        uint16_t value = WADData::LoadUInt16LE(buffer + offset);
 		offset += 2;
 		return value;
 	}
@@ -37,12 +53,11 @@ namespace WADReader
 		return value;
     }
 
-    std::string ReadName(uint8_t* buffer, size_t& offset)
+    WADData::WadName ReadName(uint8_t* buffer, size_t& offset)
     {
-        char nameBuffer[9] = { 0 };
-        memcpy(nameBuffer, buffer + offset, 8);
+        WADData::WadName name = WADData::WadName::FromBytes(buffer + offset);
         offset += 8;
-        return std::string(nameBuffer);
+        return name;
     }
 
     WADData::DirectoryEntry ReadDirectoryEntry(uint8_t* buffer, size_t& readOffset)
@@ -67,12 +82,137 @@ namespace WADReader
         size_t dirOffset = ReadInt(buffer, offset);
 
         std::vector<WADData::DirectoryEntry> entries;
+        if (lumpCount <= 0)
+            return entries;
 
-        for (size_t lump = 0; lump < lumpCount; lump++)
+        entries.reserve(size_t(lumpCount));
+        for (size_t lump = 0; lump < size_t(lumpCount); lump++)
         {
             entries.push_back(ReadDirectoryEntry(buffer, dirOffset));
         }
 
         return entries;
     }
-}
\ No newline at end of file
+
+    std::vector<WADData::DirectoryEntry> ReadDirectoryEntries(LumpSource& source)
+    {
+        std::vector<WADData::DirectoryEntry> entries;
+
+        uint8_t* buffer = source.GetBuffer();
+        if (buffer)
+        {
+            if (source.GetSize() < 12)
+                return entries;
+
+            entries = ReadDirectoryEntries(buffer);
+        }
+        else
+        {
+            uint8_t header[12];
+            if (!source.Read(0, sizeof(header), header))
+                return entries;
+
+            size_t offset = 4;
+            int32_t lumpCount = ReadInt(header, offset);
+            size_t dirOffset = ReadInt(header, offset);
+
+            if (lumpCount <= 0)
+                return entries;
+
+            // only the directory itself is read, lumps are fetched when they are used
+            std::vector<uint8_t> directory(size_t(lumpCount) * 16);
+            if (!source.Read(dirOffset, directory.size(), directory.data()))
+                return entries;
+
+            entries.reserve(size_t(lumpCount));
+
+            size_t readOffset = 0;
+            for (int32_t lump = 0; lump < lumpCount; lump++)
+            {
+                entries.push_back(ReadDirectoryEntry(directory.data(), readOffset));
+                entries.back().BufferData = nullptr;
+            }
+        }
+
+        for (auto& entry : entries)
+            entry.Source = &source;
+
+        return entries;
+    }
+
+    void DecodeInt16Pairs(const uint8_t* source, size_t count, Vector2* destination, float scale)
+    {
+        // Vector2 is two floats, so the output is written as one flat float array
+        float* output = &destination[0].x;
+        size_t values = count * 2;
+        size_t i = 0;
+
+#if defined(WAD_READER_AVX2)
+        __m256 scales = _mm256_set1_ps(scale);
+        for (; i + 8 <= values; i += 8)
+        {
+            __m256i wide = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(source + i * 2)));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(wide), scales));
+        }
+#elif defined(WAD_READER_SSE2)
+        __m128 scales = _mm_set1_ps(scale);
+        for (; i + 8 <= values; i += 8)
+        {
+            __m128i packed = _mm_loadu_si128((const __m128i*)(source + i * 2));
+
+            // put each int16 in the top half of an int32, then shift it down to sign extend it
+            __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scales));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scales));
+        }
+#elif defined(WAD_READER_NEON)
+        for (; i + 8 <= values; i += 8)
+        {
+            int16x8_t packed = vreinterpretq_s16_u8(vld1q_u8(source + i * 2));
+
+            vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed))), scale));
+            vst1q_f32(output + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed))), scale));
+        }
+#endif
+
+        for (; i < values; i++)
+            output[i] = WADData::LoadInt16LE(source + i * 2) * scale;
+    }
+
+    void DecodeFixedPairs(const uint8_t* source, size_t count, Vector2* destination, float scale)
+    {
+        float* output = &destination[0].x;
+        size_t values = count * 2;
+        size_t i = 0;
+
+        // the scales used are powers of two, so folding the fixed point divide into them doesn't change the result
+        float fixedScale = scale / 65536.0f;
+
+#if defined(WAD_READER_AVX2)
+        __m256 scales = _mm256_set1_ps(fixedScale);
+        for (; i + 8 <= values; i += 8)
+        {
+            __m256i fixed = _mm256_loadu_si256((const __m256i*)(source + i * 4));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(fixed), scales));
+        }
+#elif defined(WAD_READER_SSE2)
+        __m128 scales = _mm_set1_ps(fixedScale);
+        for (; i + 4 <= values; i += 4)
+        {
+            __m128i fixed = _mm_loadu_si128((const __m128i*)(source + i * 4));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(fixed), scales));
+        }
+#elif defined(WAD_READER_NEON)
+        for (; i + 4 <= values; i += 4)
+        {
+            int32x4_t fixed = vreinterpretq_s32_u8(vld1q_u8(source + i * 4));
+            vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(fixed), fixedScale));
+        }
+#endif
+
+        for (; i < values; i++)
+            output[i] = float(WADData::LoadInt32LE(source + i * 4)) * fixedScale;
+    }
+}
@@ -0,0 +1,25 @@
+#include "resource_stack.h"
+
+bool ResourceStack::Mount(const char* fileName)
+{
+    if (!MountArchive(fileName))
+        return false;
+
+    BuildDirectory();
+    return true;
+}
+
+size_t ResourceStack::Mount(const std::vector<std::string>& fileNames)
+{
+    size_t mounted = 0;
+    for (const auto& fileName : fileNames)
+    {
+        if (MountArchive(fileName.c_str()))
+            mounted++;
+    }
+
+    if (mounted > 0)
+        BuildDirectory();
+
+    return mounted;
+}
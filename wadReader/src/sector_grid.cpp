@@ -0,0 +1,137 @@
+#include "sector_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace WADData
+{
+    void SectorGrid::Clear()
+    {
+        Cells.clear();
+        Cells.shrink_to_fit();
+        Columns = 0;
+        Rows = 0;
+        MixedCount = 0;
+    }
+
+    bool SectorGrid::Build(const VertexTable& vertices, Span<const uint32_t> segStarts, Span<const uint32_t> segEnds, const GLSubSectorsLump& subSectors, Span<const uint32_t> subSectorSectors, float cellSize)
+    {
+        Clear();
+
+        if (vertices.empty() || !(cellSize > 0) || segStarts.size() != segEnds.size() || subSectorSectors.size() < subSectors.Contents.size())
+            return false;
+
+        Rectangle bounds = vertices.GetBounds();
+
+        // a cell of border all round, points just off the map's edge still count as on it for an exact lookup
+        double columns = std::floor(bounds.width / cellSize) + 3;
+        double rows = std::floor(bounds.height / cellSize) + 3;
+        if (columns * rows > double(MaxCells))
+            return false;
+
+        OriginX = bounds.x - cellSize;
+        OriginY = bounds.y - cellSize;
+        CellSize = cellSize;
+        InverseCellSize = 1.0f / cellSize;
+        Columns = int32_t(columns);
+        Rows = int32_t(rows);
+
+        Cells.assign(size_t(Columns) * size_t(Rows), Outside);
+
+        std::vector<Vector2> polygon;
+        for (size_t subSectorID = 0; subSectorID < subSectors.Contents.size(); subSectorID++)
+        {
+            uint32_t sector = subSectorSectors[subSectorID];
+            if (sector == uint32_t(-1))
+                continue;
+
+            if (sector >= Mixed)
+            {
+                Clear();
+                return false;
+            }
+
+            const auto& subSector = subSectors.Contents[subSectorID];
+            if (subSector.Count < 3 || subSector.StartSegment + subSector.Count > segStarts.size())
+                continue;
+
+            polygon.clear();
+            for (size_t seg = subSector.StartSegment; seg < subSector.StartSegment + subSector.Count; seg++)
+                polygon.push_back(vertices.Get(segStarts[seg]));
+
+            // GL subsectors wind clockwise, the sign of the area is checked anyway so the inside is known for either winding
+            double area = 0;
+            float minX = polygon[0].x, minY = polygon[0].y, maxX = polygon[0].x, maxY = polygon[0].y;
+            for (size_t i = 0; i < polygon.size(); i++)
+            {
+                const Vector2& a = polygon[i];
+                const Vector2& b = polygon[(i + 1) % polygon.size()];
+                area += double(a.x) * b.y - double(b.x) * a.y;
+
+                minX = std::min(minX, a.x);
+                minY = std::min(minY, a.y);
+                maxX = std::max(maxX, a.x);
+                maxY = std::max(maxY, a.y);
+            }
+
+            if (area == 0)
+                continue;
+
+            float winding = area > 0 ? 1.0f : -1.0f;
+
+            // one more cell each way, an edge that lies on a cell boundary still touches the cell on its other side
+            int32_t firstColumn = std::max(int32_t(std::floor((minX - OriginX) * InverseCellSize)) - 1, 0);
+            int32_t lastColumn = std::min(int32_t(std::floor((maxX - OriginX) * InverseCellSize)) + 1, Columns - 1);
+            int32_t firstRow = std::max(int32_t(std::floor((minY - OriginY) * InverseCellSize)) - 1, 0);
+            int32_t lastRow = std::min(int32_t(std::floor((maxY - OriginY) * InverseCellSize)) + 1, Rows - 1);
+
+            for (int32_t row = firstRow; row <= lastRow; row++)
+            {
+                float bottom = OriginY + row * CellSize;
+                float top = bottom + CellSize;
+
+                for (int32_t column = firstColumn; column <= lastColumn; column++)
+                {
+                    float left = OriginX + column * CellSize;
+                    float right = left + CellSize;
+
+                    // the cell is inside a convex polygon when all its corners are inside or on every edge,
+                    // and can't touch it when all its corners are outside any one edge
+                    bool inside = true;
+                    bool separate = false;
+                    for (size_t i = 0; i < polygon.size() && !separate; i++)
+                    {
+                        const Vector2& a = polygon[i];
+                        const Vector2& b = polygon[(i + 1) % polygon.size()];
+
+                        float edgeX = b.x - a.x;
+                        float edgeY = b.y - a.y;
+                        float tolerance = 1e-4f * (std::fabs(edgeX) + std::fabs(edgeY));
+
+                        auto side = [&](float x, float y) { return winding * (edgeX * (y - a.y) - edgeY * (x - a.x)); };
+
+                        float corners[4] = { side(left, bottom), side(right, bottom), side(left, top), side(right, top) };
+                        float lowest = std::min(std::min(corners[0], corners[1]), std::min(corners[2], corners[3]));
+                        float highest = std::max(std::max(corners[0], corners[1]), std::max(corners[2], corners[3]));
+
+                        inside &= lowest >= -tolerance;
+                        separate |= highest < -tolerance;
+                    }
+
+                    if (separate)
+                        continue;
+
+                    // a cell inside one subsector belongs to its sector, even if a neighbour's edge only touches it
+                    uint16_t& cell = Cells[size_t(row) * Columns + column];
+                    if (inside)
+                        cell = uint16_t(sector);
+                    else if (cell == Outside)
+                        cell = Mixed;
+                }
+            }
+        }
+
+        MixedCount = size_t(std::count(Cells.begin(), Cells.end(), Mixed));
+        return true;
+    }
+}
@@ -0,0 +1,773 @@
+#include "lump_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+namespace WADData
+{
+    static bool IsSpace(char c) { return uint8_t(c) <= ' '; }
+    static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool IsLetter(char c) { return uint8_t(c | 0x20) >= 'a' && uint8_t(c | 0x20) <= 'z'; }
+    static bool IsIdentifierChar(char c) { return IsLetter(c) || IsDigit(c) || c == '_'; }
+
+    static const char* SkipSpace(const char* text, const char* end)
+    {
+        while (text < end && IsSpace(*text))
+            text++;
+        return text;
+    }
+
+    static const char* SkipIdentifier(const char* text, const char* end)
+    {
+        while (text < end && IsIdentifierChar(*text))
+            text++;
+        return text;
+    }
+
+    // numbers are read as identifier characters (hex digits, x and e) and points, the value parser checks what they spell
+    static const char* SkipNumber(const char* text, const char* end)
+    {
+        while (text < end && (IsIdentifierChar(*text) || *text == '.'))
+            text++;
+
+        // an exponent's sign is the only other character a number can have
+        while (text < end && (*text == '+' || *text == '-') && (text[-1] | 0x20) == 'e')
+            text = SkipNumber(text + 1, end);
+        return text;
+    }
+
+    // the closing quote or an escape
+    static const char* FindStringStop(const char* text, const char* end)
+    {
+        while (text < end && *text != '"' && *text != '\\')
+            text++;
+        return text;
+    }
+
+    enum class TokenType
+    {
+        End,
+        Identifier,
+        Number,
+        String,
+        Symbol,
+        Error,
+    };
+
+    // a token points into the lump text, strings are left with their escapes in and without their quotes
+    struct Token
+    {
+        TokenType Type = TokenType::End;
+        std::string_view Text;
+
+        bool IsSymbol(char c) const { return Type == TokenType::Symbol && Text[0] == c; }
+    };
+
+    // splits the text into tokens without copying or allocating, comments are skipped like whitespace
+    class TextMapTokenizer
+    {
+    public:
+        TextMapTokenizer(const char* text, size_t size) : Start(text), Position(text), End(text + size) {}
+
+        Token Next()
+        {
+            if (!SkipComments())
+                return Token{ TokenType::Error, std::string_view(Position, 0) };
+
+            if (Position == End)
+                return Token{ TokenType::End, std::string_view(Position, 0) };
+
+            const char* start = Position;
+            char c = *Position;
+
+            if (IsLetter(c) || c == '_')
+            {
+                Position = SkipIdentifier(Position + 1, End);
+                return Token{ TokenType::Identifier, std::string_view(start, Position - start) };
+            }
+
+            if (IsDigit(c) || c == '-' || c == '+' || c == '.')
+            {
+                Position = SkipNumber(Position + 1, End);
+                return Token{ TokenType::Number, std::string_view(start, Position - start) };
+            }
+
+            if (c == '"')
+            {
+                Position++;
+                for (;;)
+                {
+                    Position = FindStringStop(Position, End);
+                    if (Position == End || (*Position == '\\' && End - Position < 2))
+                    {
+                        Position = start;
+                        return Token{ TokenType::Error, std::string_view(start, 0) };
+                    }
+
+                    if (*Position == '"')
+                        break;
+
+                    Position += 2;
+                }
+
+                Position++;
+                return Token{ TokenType::String, std::string_view(start + 1, Position - start - 2) };
+            }
+
+            Position++;
+            return Token{ TokenType::Symbol, std::string_view(start, 1) };
+        }
+
+        // steps over the symbol when it is next, punctuation the grammar expects doesn't need a whole token
+        bool SkipSymbol(char c)
+        {
+            if (!SkipComments() || Position == End || *Position != c)
+                return false;
+
+            Position++;
+            return true;
+        }
+
+        // only worked out for warnings, counting lines as tokens are read would slow every map down
+        size_t GetLine() const
+        {
+            size_t line = 1;
+            for (const char* text = Start; text < Position; text++)
+                line += *text == '\n';
+            return line;
+        }
+
+    protected:
+        bool SkipComments()
+        {
+            for (;;)
+            {
+                Position = SkipSpace(Position, End);
+                if (End - Position < 2 || Position[0] != '/')
+                    return true;
+
+                if (Position[1] == '/')
+                {
+                    const char* lineEnd = (const char*)memchr(Position, '\n', End - Position);
+                    Position = lineEnd ? lineEnd + 1 : End;
+                }
+                else if (Position[1] == '*')
+                {
+                    const char* text = Position + 2;
+                    for (;;)
+                    {
+                        text = (const char*)memchr(text, '*', End - text);
+                        if (!text || End - text < 2)
+                            return false;
+                        if (text[1] == '/')
+                            break;
+                        text++;
+                    }
+                    Position = text + 2;
+                }
+                else
+                {
+                    return true;
+                }
+            }
+        }
+
+        const char* Start = nullptr;
+        const char* Position = nullptr;
+        const char* End = nullptr;
+    };
+
+    static double PowerOfTen(int exponent)
+    {
+        // every power up to 22 is exact in a double
+        static constexpr double exact[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        if (exponent >= 0 && exponent <= 22)
+            return exact[exponent];
+        if (exponent < 0 && exponent >= -22)
+            return 1.0 / exact[-exponent];
+        return std::pow(10.0, exponent);
+    }
+
+    // UDMF numbers are C style, decimal or 0x hex integers and decimal floats with an optional exponent
+    static bool ParseNumber(std::string_view text, double& value)
+    {
+        size_t i = 0;
+        bool negative = false;
+        if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+            negative = text[i++] == '-';
+
+        if (text.size() - i > 2 && text[i] == '0' && (text[i + 1] | 0x20) == 'x')
+        {
+            uint64_t hex = 0;
+            for (i += 2; i < text.size(); i++)
+            {
+                char c = text[i];
+                int digit = IsDigit(c) ? c - '0' : ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') ? (c | 0x20) - 'a' + 10 : -1;
+                if (digit < 0)
+                    return false;
+                hex = hex * 16 + uint64_t(digit);
+            }
+
+            value = negative ? -double(hex) : double(hex);
+            return true;
+        }
+
+        // digits past the 19 a uint64 holds only move the exponent
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool anyDigits = false;
+
+        for (; i < text.size() && IsDigit(text[i]); i++, anyDigits = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + uint64_t(text[i] - '0');
+                digits += mantissa != 0;
+            }
+            else
+            {
+                exponent++;
+            }
+        }
+
+        if (i < text.size() && text[i] == '.')
+        {
+            for (i++; i < text.size() && IsDigit(text[i]); i++, anyDigits = true)
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + uint64_t(text[i] - '0');
+                    digits += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+
+        if (!anyDigits)
+            return false;
+
+        if (i < text.size() && (text[i] | 0x20) == 'e')
+        {
+            i++;
+            bool negativeExponent = false;
+            if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+                negativeExponent = text[i++] == '-';
+
+            if (i == text.size())
+                return false;
+
+            int written = 0;
+            for (; i < text.size() && IsDigit(text[i]); i++)
+                written = written < 10000 ? written * 10 + (text[i] - '0') : written;
+
+            exponent += negativeExponent ? -written : written;
+        }
+
+        if (i != text.size())
+            return false;
+
+        value = double(mantissa) * PowerOfTen(exponent);
+        if (negative)
+            value = -value;
+        return true;
+    }
+
+    // the binary lumps' whole map units, clamped to what they can hold
+    static int16_t ToMapUnits(double value)
+    {
+        return int16_t(std::max(-32768.0, std::min(32767.0, std::round(value))));
+    }
+
+    // reads the blocks UDMFLump keeps into its lumps, and skips the rest
+    class TextMapReader
+    {
+    public:
+        TextMapReader(UDMFLump& lump, const char* text, size_t size, const ParseContext& context)
+            : Lump(lump), Tokens(text, size), Textures(context.TextureNames), Flats(context.FlatNames)
+        {
+        }
+
+        bool Read()
+        {
+            for (;;)
+            {
+                Token name = Tokens.Next();
+                if (name.Type == TokenType::End)
+                    return true;
+
+                if (name.Type != TokenType::Identifier)
+                    return Fail("a block or a global");
+
+                if (Tokens.SkipSymbol('='))
+                {
+                    Token value;
+                    if (!ReadValue(value))
+                        return false;
+
+                    if (name.Text == "namespace" && value.Type == TokenType::String)
+                        Lump.Namespace = std::string(value.Text);
+                    continue;
+                }
+
+                if (!Tokens.SkipSymbol('{'))
+                    return Fail("'=' or '{'");
+
+                if (!ReadBlock(GetBlockType(name.Text)))
+                    return false;
+            }
+        }
+
+        // the vertex positions as written, the vertex lump only has whole map units
+        std::vector<Vector2> Positions;
+
+        std::vector<LineDefLump::LineDef> LineDefs;
+
+        // arg0, the tag of the Hexen style namespaces, which have no line id
+        std::vector<uint16_t> LineTags;
+
+    protected:
+        enum class BlockType
+        {
+            Other,
+            Vertex,
+            LineDef,
+            SideDef,
+            Sector,
+            Thing,
+        };
+
+        static BlockType GetBlockType(std::string_view name)
+        {
+            if (name == "vertex")
+                return BlockType::Vertex;
+            if (name == "linedef")
+                return BlockType::LineDef;
+            if (name == "sidedef")
+                return BlockType::SideDef;
+            if (name == "sector")
+                return BlockType::Sector;
+            if (name == "thing")
+                return BlockType::Thing;
+            return BlockType::Other;
+        }
+
+        bool Fail(const char* expected)
+        {
+            TraceLog(LOG_WARNING, "WAD: TEXTMAP line %zu, expected %s", Tokens.GetLine(), expected);
+            return false;
+        }
+
+        // value ';'
+        bool ReadValue(Token& value)
+        {
+            value = Tokens.Next();
+            if (value.Type != TokenType::Identifier && value.Type != TokenType::Number && value.Type != TokenType::String)
+                return Fail("a value");
+
+            if (!Tokens.SkipSymbol(';'))
+                return Fail("';'");
+
+            return true;
+        }
+
+        bool ReadBlock(BlockType type)
+        {
+            switch (type)
+            {
+            case BlockType::Vertex:
+                Positions.emplace_back(Vector2{ 0, 0 });
+                break;
+            case BlockType::LineDef:
+                LineDefs.emplace_back();
+                LineDefs.back().SectorTag = 0;
+                LineTags.push_back(0);
+                break;
+            case BlockType::SideDef:
+                Lump.Sides.Contents.emplace_back();
+                break;
+            case BlockType::Sector:
+                Lump.Sectors.Contents.emplace_back();
+                // UDMF's default light level
+                Lump.Sectors.Contents.back().LightLevel = 160;
+                break;
+            case BlockType::Thing:
+                Lump.Things.Contents.emplace_back();
+                // every flag defaults to false, so a thing is left out of single player unless it says otherwise
+                Lump.Things.Contents.back().Flags = 0x0010;
+                break;
+            default:
+                break;
+            }
+
+            for (;;)
+            {
+                Token key = Tokens.Next();
+                if (key.IsSymbol('}'))
+                    return true;
+
+                if (key.Type != TokenType::Identifier)
+                    return Fail("a field or '}'");
+
+                if (!Tokens.SkipSymbol('='))
+                    return Fail("'='");
+
+                Token value;
+                if (!ReadValue(value))
+                    return false;
+
+                if (!SetField(type, key.Text, value))
+                    return false;
+            }
+        }
+
+        bool GetNumber(const Token& value, double& number)
+        {
+            if (value.Type != TokenType::Number || !ParseNumber(value.Text, number))
+                return Fail("a number");
+            return true;
+        }
+
+        bool GetInteger(const Token& value, int64_t& integer)
+        {
+            double number = 0;
+            if (!GetNumber(value, number))
+                return false;
+
+            integer = int64_t(std::llround(number));
+            return true;
+        }
+
+        // names are 8 characters in the binary lumps, longer ones are cut
+        bool GetName(const Token& value, WadName& name)
+        {
+            if (value.Type != TokenType::String)
+                return Fail("a string");
+
+            char text[9] = { 0 };
+            memcpy(text, value.Text.data(), std::min<size_t>(value.Text.size(), 8));
+            name = WadName(text);
+            return true;
+        }
+
+        // -1 is no index, which the binary lumps store as 0xFFFF
+        bool GetIndex(const Token& value, uint16_t& index)
+        {
+            int64_t integer = 0;
+            if (!GetInteger(value, integer))
+                return false;
+
+            if (integer == -1)
+            {
+                index = 0xFFFF;
+                return true;
+            }
+
+            if (integer < 0 || integer >= 0xFFFF)
+            {
+                TraceLog(LOG_WARNING, "WAD: TEXTMAP line %zu, index %lld doesn't fit the binary map lumps", Tokens.GetLine(), (long long)integer);
+                return false;
+            }
+
+            index = uint16_t(integer);
+            return true;
+        }
+
+        static void SetFlag(uint16_t& flags, uint16_t flag, bool set)
+        {
+            if (set)
+                flags |= flag;
+            else
+                flags &= ~flag;
+        }
+
+        bool SetField(BlockType type, std::string_view key, const Token& value)
+        {
+            switch (type)
+            {
+            case BlockType::Vertex:
+                return SetVertexField(Positions.back(), key, value);
+            case BlockType::LineDef:
+                return SetLineDefField(LineDefs.back(), LineTags.back(), key, value);
+            case BlockType::SideDef:
+                return SetSideDefField(Lump.Sides.Contents.back(), key, value);
+            case BlockType::Sector:
+                return SetSectorField(Lump.Sectors.Contents.back(), key, value);
+            case BlockType::Thing:
+                return SetThingField(Lump.Things.Contents.back(), key, value);
+            default:
+                return true;
+            }
+        }
+
+        bool SetVertexField(Vector2& position, std::string_view key, const Token& value)
+        {
+            double number = 0;
+            if (key == "x" || key == "y")
+            {
+                if (!GetNumber(value, number))
+                    return false;
+                (key == "x" ? position.x : position.y) = float(number);
+            }
+            return true;
+        }
+
+        bool SetLineDefField(LineDefLump::LineDef& line, uint16_t& tag, std::string_view key, const Token& value)
+        {
+            int64_t integer = 0;
+
+            if (key == "v1")
+                return GetIndex(value, line.Start);
+            if (key == "v2")
+                return GetIndex(value, line.End);
+            if (key == "sidefront")
+                return GetIndex(value, line.FrontSideDef);
+            if (key == "sideback")
+                return GetIndex(value, line.BackSideDef);
+
+            if (key == "special" || key == "id" || key == "arg0")
+            {
+                if (!GetInteger(value, integer))
+                    return false;
+
+                if (key == "special")
+                    line.SpecialType = uint16_t(integer);
+                else if (key == "id")
+                    line.SectorTag = uint16_t(std::max<int64_t>(integer, 0));
+                else
+                    tag = uint16_t(integer);
+                return true;
+            }
+
+            static constexpr std::pair<std::string_view, uint16_t> flags[] =
+            {
+                { "blocking", 0x0001 }, { "blockmonsters", 0x0002 }, { "twosided", 0x0004 }, { "dontpegtop", 0x0008 }, { "dontpegbottom", 0x0010 },
+                { "secret", 0x0020 }, { "blocksound", 0x0040 }, { "dontdraw", 0x0080 }, { "mapped", 0x0100 },
+            };
+
+            for (const auto& [name, flag] : flags)
+            {
+                if (key == name)
+                {
+                    SetFlag(line.Flags, flag, value.Text == "true");
+                    break;
+                }
+            }
+            return true;
+        }
+
+        bool SetSideDefField(SideDefLump::SideDef& side, std::string_view key, const Token& value)
+        {
+            WadName name;
+            int64_t integer = 0;
+
+            if (key == "sector")
+                return GetIndex(value, side.SectorId);
+
+            if (key == "offsetx" || key == "offsety")
+            {
+                if (!GetInteger(value, integer))
+                    return false;
+                (key == "offsetx" ? side.XOffset : side.YOffset) = int16_t(integer);
+                side.Offset = Vector2{ side.XOffset * MapScale, side.YOffset * MapScale };
+                return true;
+            }
+
+            if (key == "texturetop" || key == "texturebottom" || key == "texturemiddle")
+            {
+                if (!GetName(value, name))
+                    return false;
+
+                uint16_t id = Textures.Intern(name);
+                if (key == "texturetop")
+                    side.TopTexture = id;
+                else if (key == "texturebottom")
+                    side.LowerTexture = id;
+                else
+                    side.MidTexture = id;
+            }
+            return true;
+        }
+
+        bool SetSectorField(SectorsLump::Sector& sector, std::string_view key, const Token& value)
+        {
+            WadName name;
+            double number = 0;
+
+            if (key == "heightfloor" || key == "heightceiling")
+            {
+                if (!GetNumber(value, number))
+                    return false;
+
+                if (key == "heightfloor")
+                {
+                    sector.FloorHeight = ToMapUnits(number);
+                    sector.Floor = float(number) * MapScale;
+                }
+                else
+                {
+                    sector.CeilingHeight = ToMapUnits(number);
+                    sector.Ceiling = float(number) * MapScale;
+                }
+                return true;
+            }
+
+            if (key == "texturefloor" || key == "textureceiling")
+            {
+                if (!GetName(value, name))
+                    return false;
+                (key == "texturefloor" ? sector.FloorTexture : sector.CeilingTexture) = Flats.Intern(name);
+                return true;
+            }
+
+            if (key == "lightlevel" || key == "special" || key == "id")
+            {
+                if (!GetNumber(value, number))
+                    return false;
+
+                if (key == "lightlevel")
+                    sector.LightLevel = int16_t(number);
+                else if (key == "special")
+                    sector.SpecialType = uint16_t(number);
+                else
+                    sector.TagNumber = uint16_t(std::max(number, 0.0));
+            }
+            return true;
+        }
+
+        bool SetThingField(ThingsLump::Thing& thing, std::string_view key, const Token& value)
+        {
+            double number = 0;
+
+            if (key == "x" || key == "y" || key == "angle" || key == "type")
+            {
+                if (!GetNumber(value, number))
+                    return false;
+
+                if (key == "x")
+                {
+                    thing.X = ToMapUnits(number);
+                    thing.Position.x = float(number) * MapScale;
+                }
+                else if (key == "y")
+                {
+                    thing.Y = ToMapUnits(number);
+                    thing.Position.y = float(number) * MapScale;
+                }
+                else if (key == "angle")
+                {
+                    thing.BinAngle = ToMapUnits(number);
+                    thing.Angle = float(thing.BinAngle);
+                }
+                else
+                {
+                    thing.TypeId = uint16_t(number);
+                }
+                return true;
+            }
+
+            // skill 1 and 2 share the easy flag, as do 4 and 5 the hard one
+            if (key == "skill1" || key == "skill2")
+                SetFlag(thing.Flags, 0x0001, value.Text == "true");
+            else if (key == "skill3")
+                SetFlag(thing.Flags, 0x0002, value.Text == "true");
+            else if (key == "skill4" || key == "skill5")
+                SetFlag(thing.Flags, 0x0004, value.Text == "true");
+            else if (key == "ambush")
+                SetFlag(thing.Flags, 0x0008, value.Text == "true");
+            else if (key == "single")
+                SetFlag(thing.Flags, 0x0010, value.Text != "true");
+            return true;
+        }
+
+        UDMFLump& Lump;
+        TextMapTokenizer Tokens;
+
+        NameInterner Textures;
+        NameInterner Flats;
+    };
+
+    static void WriteUInt16(std::vector<uint8_t>& output, size_t offset, uint16_t value)
+    {
+        output[offset] = uint8_t(value);
+        output[offset + 1] = uint8_t(value >> 8);
+    }
+
+    void UDMFLump::Parse(uint8_t* data, size_t offset, size_t size, const ParseContext& context)
+    {
+        Valid = false;
+
+        TextMapReader reader(*this, (const char*)data + offset, size, context);
+        if (!reader.Read())
+            return;
+
+        // the Doom namespaces tag sectors with the line id, the rest use the special's first argument
+        bool doomTags = Namespace == "doom" || Namespace == "heretic" || Namespace == "strife";
+        if (!doomTags)
+        {
+            for (size_t i = 0; i < reader.LineDefs.size(); i++)
+                reader.LineDefs[i].SectorTag = reader.LineTags[i];
+        }
+
+        size_t vertexCount = reader.Positions.size();
+        if (vertexCount >= 0xFFFF || reader.LineDefs.size() >= 0xFFFF || Sides.Contents.size() >= 0xFFFF || Sectors.Contents.size() >= 0xFFFF)
+        {
+            TraceLog(LOG_WARNING, "WAD: TEXTMAP is too large for 16 bit map indexes");
+            return;
+        }
+
+        for (const auto& line : reader.LineDefs)
+        {
+            if (line.Start >= vertexCount || line.End >= vertexCount || line.FrontSideDef >= Sides.Contents.size()
+                || (line.BackSideDef != InvalidSideDefIndex && line.BackSideDef >= Sides.Contents.size()))
+            {
+                TraceLog(LOG_WARNING, "WAD: TEXTMAP has a linedef with a missing vertex or sidedef");
+                return;
+            }
+        }
+
+        for (const auto& side : Sides.Contents)
+        {
+            if (side.SectorId >= Sectors.Contents.size())
+            {
+                TraceLog(LOG_WARNING, "WAD: TEXTMAP has a sidedef with a missing sector");
+                return;
+            }
+        }
+
+        // the vertex and linedef lumps view binary records, so they are written out and parsed like any other map
+        VertexRecords.resize(vertexCount * VertexesLump::Vertex::ReadSize);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            WriteUInt16(VertexRecords, i * 4, uint16_t(ToMapUnits(reader.Positions[i].x)));
+            WriteUInt16(VertexRecords, i * 4 + 2, uint16_t(ToMapUnits(reader.Positions[i].y)));
+        }
+
+        LineRecords.resize(reader.LineDefs.size() * LineDefLump::LineDef::ReadSize);
+        for (size_t i = 0; i < reader.LineDefs.size(); i++)
+        {
+            const auto& line = reader.LineDefs[i];
+            size_t record = i * LineDefLump::LineDef::ReadSize;
+
+            uint16_t fields[] = { line.Start, line.End, line.Flags, line.SpecialType, line.SectorTag, line.FrontSideDef, line.BackSideDef };
+            for (size_t field = 0; field < 7; field++)
+                WriteUInt16(LineRecords, record + field * 2, fields[field]);
+        }
+
+        Verts.Parse(VertexRecords.data(), 0, VertexRecords.size(), context);
+        Lines.Parse(LineRecords.data(), 0, LineRecords.size(), context);
+
+        // the positions as written, so fractional vertices aren't moved
+        for (size_t i = 0; i < vertexCount; i++)
+            Verts.Positions[i] = Vector2{ reader.Positions[i].x * MapScale, reader.Positions[i].y * MapScale };
+
+        for (auto& thing : Things.Contents)
+            Things.ThingsByType[thing.TypeId].push_back(&thing);
+
+        Valid = true;
+    }
+}
@@ -0,0 +1,58 @@
+#include "vertex_table.h"
+
+namespace WADData
+{
+    void VertexTable::Clear()
+    {
+        Xs.clear();
+        Ys.clear();
+        GLBase = 0;
+    }
+
+    void VertexTable::Build(const VertexesLump* verts, const GLVertsLump* glVerts)
+    {
+        Clear();
+
+        size_t vertCount = verts ? verts->Positions.size() : 0;
+        size_t glVertCount = glVerts ? glVerts->Contents.size() : 0;
+
+        GLBase = vertCount;
+        Xs.resize(vertCount + glVertCount);
+        Ys.resize(vertCount + glVertCount);
+
+        for (size_t i = 0; i < vertCount; i++)
+        {
+            Xs[i] = verts->Positions[i].x;
+            Ys[i] = verts->Positions[i].y;
+        }
+
+        for (size_t i = 0; i < glVertCount; i++)
+        {
+            Xs[GLBase + i] = glVerts->Contents[i].x;
+            Ys[GLBase + i] = glVerts->Contents[i].y;
+        }
+    }
+
+    Rectangle VertexTable::GetBounds() const
+    {
+        if (Xs.empty())
+            return Rectangle{ 0, 0, 0, 0 };
+
+        // separate branch free min/max loops over each array, so the compiler can vectorize them
+        float minX = Xs[0], maxX = Xs[0];
+        for (float x : Xs)
+        {
+            minX = x < minX ? x : minX;
+            maxX = x > maxX ? x : maxX;
+        }
+
+        float minY = Ys[0], maxY = Ys[0];
+        for (float y : Ys)
+        {
+            minY = y < minY ? y : minY;
+            maxY = y > maxY ? y : maxY;
+        }
+
+        return Rectangle{ minX, minY, maxX - minX, maxY - minY };
+    }
+}